@@ -0,0 +1,707 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <flood/in_stream.h>
+#include <flood/out_stream.h>
+#include <imprint/allocator.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <swamp-typeinfo/add.h>
+#include <swamp-typeinfo/builder.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/equal.h>
+#include <swamp-typeinfo/image.h>
+#include <swamp-typeinfo/pack.h>
+#include <swamp-typeinfo/pointer_map.h>
+#include <swamp-typeinfo/record.h>
+#include <swamp-typeinfo/typeinfo.h>
+#include <swamp-typeinfo/value.h>
+#include <time.h>
+
+clog_config g_clog;
+char g_clog_temp_str[CLOG_TEMP_STR_SIZE];
+
+#define BENCH_ARENA_BLOCK_SIZE (64 * 1024 * 1024)
+#define BENCH_DEEP_RECORD_DEPTH (32)
+#define BENCH_RECORD_FIELD_COUNT (8)
+#define BENCH_CUSTOM_VARIANT_COUNT (16)
+#define BENCH_ALIAS_CHAIN_LENGTH (16)
+#define BENCH_BUILDER_WORKER_COUNT (4)
+
+/// Bump allocator, everything that a scenario allocates is released at once when it is done.
+typedef struct BenchArenaBlock {
+    struct BenchArenaBlock* previous;
+    size_t used;
+    size_t size;
+} BenchArenaBlock;
+
+typedef struct BenchArena {
+    ImprintAllocator info;
+    BenchArenaBlock* block;
+} BenchArena;
+
+static void* arenaAlloc(void* self, size_t size, const char* sourceFile, size_t line, const char* description)
+{
+    BenchArena* arena = (BenchArena*) self;
+    size = (size + 15) & ~(size_t) 15;
+    BenchArenaBlock* block = arena->block;
+    if (block == 0 || block->used + size > block->size) {
+        size_t blockSize = size > BENCH_ARENA_BLOCK_SIZE ? size : BENCH_ARENA_BLOCK_SIZE;
+        BenchArenaBlock* newBlock = malloc(sizeof(BenchArenaBlock) + 16 + blockSize);
+        if (newBlock == 0) {
+            fprintf(stderr, "bench: out of memory\n");
+            exit(1);
+        }
+        newBlock->previous = block;
+        newBlock->used = 0;
+        newBlock->size = blockSize;
+        arena->block = block = newBlock;
+    }
+
+    uint8_t* start = (uint8_t*) (((uintptr_t) (block + 1) + 15) & ~(uintptr_t) 15);
+    void* p = start + block->used;
+    block->used += size;
+
+    return p;
+}
+
+static void* arenaCalloc(void* self, size_t size, const char* sourceFile, size_t line, const char* description)
+{
+    void* p = arenaAlloc(self, size, sourceFile, line, description);
+    memset(p, 0, size);
+
+    return p;
+}
+
+static void arenaInit(BenchArena* self)
+{
+    self->info.allocDebugFn = arenaAlloc;
+    self->info.callocDebugFn = arenaCalloc;
+    self->block = 0;
+}
+
+static void arenaDestroy(BenchArena* self)
+{
+    BenchArenaBlock* block = self->block;
+    while (block != 0) {
+        BenchArenaBlock* previous = block->previous;
+        free(block);
+        block = previous;
+    }
+    self->block = 0;
+}
+
+static const char* arenaString(BenchArena* arena, const char* prefix, size_t index)
+{
+    char temp[64];
+    int count = snprintf(temp, sizeof(temp), "%s%zu", prefix, index);
+    char* str = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, char, (size_t) count + 1);
+    memcpy(str, temp, (size_t) count + 1);
+
+    return str;
+}
+
+static double nowSeconds(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
+
+typedef struct BenchTypes {
+    const SwtiType** roots;
+    const char** names; // Null for generators where the roots have no names
+    size_t count;
+} BenchTypes;
+
+static SwtiIntType g_intType;
+
+static void fieldInit(SwtiRecordTypeField* field, const SwtiType* type, const char* name, size_t offset)
+{
+    SwtiMemoryInfo info = {8, 8};
+    field->fieldType = type;
+    field->name = name;
+    field->memoryOffsetInfo.memoryOffset = (SwtiMemoryOffset) offset;
+    field->memoryOffsetInfo.memoryInfo = info;
+}
+
+/// Records where each field has a unique name, so no two records are equal.
+static void generateWideRecords(BenchArena* arena, size_t count, BenchTypes* out)
+{
+    out->roots = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, const SwtiType*, count);
+    out->names = 0;
+    out->count = count;
+    for (size_t i = 0; i < count; ++i) {
+        SwtiRecordTypeField fields[BENCH_RECORD_FIELD_COUNT];
+        for (size_t f = 0; f < BENCH_RECORD_FIELD_COUNT; ++f) {
+            const char* name = arenaString(arena, f == 0 ? "id" : "field", f == 0 ? i : f);
+            fieldInit(&fields[f], &g_intType.internal, name, f * 8);
+        }
+        SwtiRecordType* record = IMPRINT_ALLOC_TYPE(&arena->info, SwtiRecordType);
+        swtiInitRecordWithFields(record, fields, BENCH_RECORD_FIELD_COUNT, &arena->info);
+        record->memoryInfo.memorySize = BENCH_RECORD_FIELD_COUNT * 8;
+        record->memoryInfo.memoryAlign = 8;
+        out->roots[i] = &record->internal;
+    }
+}
+
+/// Chains of records nested BENCH_DEEP_RECORD_DEPTH levels deep. Only the innermost record of each chain has a
+/// unique field, so every level is a distinct type.
+static void generateDeepRecords(BenchArena* arena, size_t count, BenchTypes* out)
+{
+    out->roots = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, const SwtiType*, count);
+    out->names = 0;
+    out->count = count;
+    const SwtiType* inner = 0;
+    size_t chain = 0;
+    for (size_t i = 0; i < count; ++i) {
+        SwtiRecordTypeField fields[2];
+        size_t fieldCount = 1;
+        if (i % BENCH_DEEP_RECORD_DEPTH == 0) {
+            fieldInit(&fields[0], &g_intType.internal, arenaString(arena, "leaf", chain++), 0);
+        } else {
+            fieldInit(&fields[0], &g_intType.internal, "value", 0);
+            fieldInit(&fields[1], inner, "next", 8);
+            fieldCount = 2;
+        }
+        SwtiRecordType* record = IMPRINT_ALLOC_TYPE(&arena->info, SwtiRecordType);
+        swtiInitRecordWithFields(record, fields, fieldCount, &arena->info);
+        record->memoryInfo.memorySize = (SwtiMemorySize) (fieldCount * 8);
+        record->memoryInfo.memoryAlign = 8;
+        out->roots[i] = &record->internal;
+        inner = &record->internal;
+    }
+}
+
+/// Named custom types with BENCH_CUSTOM_VARIANT_COUNT variants each.
+static void generateWideCustoms(BenchArena* arena, size_t count, BenchTypes* out)
+{
+    out->roots = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, const SwtiType*, count);
+    out->names = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, const char*, count);
+    out->count = count;
+    for (size_t i = 0; i < count; ++i) {
+        SwtiCustomTypeVariant* variants = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, SwtiCustomTypeVariant,
+                                                                   BENCH_CUSTOM_VARIANT_COUNT);
+        SwtiCustomType* custom = IMPRINT_ALLOC_TYPE(&arena->info, SwtiCustomType);
+        for (size_t v = 0; v < BENCH_CUSTOM_VARIANT_COUNT; ++v) {
+            SwtiCustomTypeVariantField field;
+            field.fieldType = &g_intType.internal;
+            field.memoryOffsetInfo.memoryOffset = 8;
+            field.memoryOffsetInfo.memoryInfo.memorySize = 8;
+            field.memoryOffsetInfo.memoryInfo.memoryAlign = 8;
+            swtiInitVariant(&variants[v], &field, 1, &arena->info);
+            ((SwtiCustomTypeVariantField*) variants[v].fields)[0].fieldType = field.fieldType;
+            // Custom type equality is structural, so the first variant name makes each custom type distinct
+            variants[v].name = v == 0 ? arenaString(arena, "First", i) : arenaString(arena, "Variant", v);
+            variants[v].inCustomType = custom;
+            variants[v].memoryInfo.memorySize = 16;
+            variants[v].memoryInfo.memoryAlign = 8;
+        }
+        out->names[i] = arenaString(arena, "Custom", i);
+        swtiInitCustom(custom, out->names[i], variants, BENCH_CUSTOM_VARIANT_COUNT, &arena->info);
+        custom->memoryInfo.memorySize = 16;
+        custom->memoryInfo.memoryAlign = 8;
+        out->roots[i] = &custom->internal;
+    }
+}
+
+/// Chains of BENCH_ALIAS_CHAIN_LENGTH aliases, each chain ending in a unique record.
+static void generateAliasChains(BenchArena* arena, size_t count, BenchTypes* out)
+{
+    out->roots = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, const SwtiType*, count);
+    out->names = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, const char*, count);
+    out->count = count;
+    const SwtiType* target = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i % BENCH_ALIAS_CHAIN_LENGTH == 0) {
+            SwtiRecordTypeField field;
+            fieldInit(&field, &g_intType.internal, arenaString(arena, "target", i), 0);
+            SwtiRecordType* record = IMPRINT_ALLOC_TYPE(&arena->info, SwtiRecordType);
+            swtiInitRecordWithFields(record, &field, 1, &arena->info);
+            record->memoryInfo.memorySize = 8;
+            record->memoryInfo.memoryAlign = 8;
+            target = &record->internal;
+        }
+        SwtiAliasType* alias = IMPRINT_ALLOC_TYPE(&arena->info, SwtiAliasType);
+        out->names[i] = arenaString(arena, "Alias", i);
+        swtiInitAlias(alias, out->names[i], target);
+        out->roots[i] = &alias->internal;
+        target = &alias->internal;
+    }
+}
+
+typedef void (*BenchGenerator)(BenchArena* arena, size_t count, BenchTypes* out);
+
+typedef struct BenchScenario {
+    const char* name;
+    BenchGenerator generate;
+} BenchScenario;
+
+static const BenchScenario g_scenarios[] = {
+    {"wide-records", generateWideRecords},
+    {"deep-records", generateDeepRecords},
+    {"wide-customs", generateWideCustoms},
+    {"alias-chains", generateAliasChains},
+};
+
+/// One JSON object per line, so results from two releases can be compared with standard tools.
+static void report(const char* scenario, size_t typeCount, const char* operation, size_t operationCount,
+                   double seconds, size_t chunkTypeCount)
+{
+    double nsPerOperation = operationCount > 0 ? seconds * 1e9 / (double) operationCount : 0;
+    printf("{\"scenario\":\"%s\",\"types\":%zu,\"operation\":\"%s\",\"count\":%zu,\"seconds\":%.6f,"
+           "\"nsPerOp\":%.1f,\"chunkTypes\":%zu}\n",
+           scenario, typeCount, operation, operationCount, seconds, nsPerOperation, chunkTypeCount);
+    fflush(stdout);
+}
+
+/// Adds the roots through a chunk builder, with the workers taking turns on this thread, and checks that the result
+/// is exactly the same chunk as when the roots are added one by one. Returns the number of differences.
+static size_t runBuilder(const char* scenario, const BenchTypes* types, const SwtiChunk* expected,
+                         const int* expectedIndices, BenchArena* arena)
+{
+    size_t count = types->count;
+    SwtiChunkBuilder builder;
+    if (swtiChunkBuilderInit(&builder, count, 0, &arena->info) < 0) {
+        return 1;
+    }
+    SwtiChunkBuilderWorker* workers = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, SwtiChunkBuilderWorker,
+                                                              BENCH_BUILDER_WORKER_COUNT);
+    for (size_t i = 0; i < BENCH_BUILDER_WORKER_COUNT; ++i) {
+        swtiChunkBuilderWorkerInit(&workers[i], &builder, &arena->info);
+    }
+
+    size_t differences = 0;
+    double start = nowSeconds();
+    for (size_t i = 0; i < count; ++i) {
+        differences += swtiChunkBuilderAdd(&workers[i % BENCH_BUILDER_WORKER_COUNT], i, types->roots[i]) < 0;
+    }
+    report(scenario, count, "builderAdd", count, nowSeconds() - start, 0);
+
+    SwtiChunk chunk;
+    swtiChunkInitWithCapacity(&chunk, count, &arena->info);
+    int* indices = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, int, count);
+    start = nowSeconds();
+    differences += swtiChunkBuilderFinish(&builder, &chunk, indices, &arena->info) < 0;
+    report(scenario, count, "builderFinish", count, nowSeconds() - start, chunk.typeCount);
+
+    if (differences == 0) {
+        differences += chunk.typeCount != expected->typeCount;
+        for (size_t i = 0; i < count; ++i) {
+            differences += indices[i] != expectedIndices[i];
+        }
+        for (size_t i = 0; i < chunk.typeCount && i < expected->typeCount; ++i) {
+            differences += swtiTypeEqual(chunk.types[i], expected->types[i]) != 0;
+        }
+    }
+
+    swtiChunkBuilderDestroy(&builder);
+    swtiChunkDestroy(&chunk);
+
+    return differences;
+}
+
+/// Counts the record fields that are not found at the same index in the chunk.
+static size_t checkRecordFields(const SwtiChunk* chunk, const SwtiChunk* expected)
+{
+    size_t differences = 0;
+    for (size_t i = 0; i < expected->typeCount; ++i) {
+        const SwtiType* type = expected->types[swtiChunkUnaliasIndex(expected, i)];
+        if (type->type != SwtiTypeRecord) {
+            continue;
+        }
+        const SwtiRecordType* record = (const SwtiRecordType*) type;
+        for (size_t f = 0; f < record->fieldCount; ++f) {
+            differences += swtiChunkFindRecordField(chunk, i, record->fields[f].name, 0) != (int) f;
+        }
+    }
+
+    return differences;
+}
+
+/// Writes the chunk to an image, reopens it and checks that the lookups in the image backed chunk give the same
+/// results as in the original chunk. The image backed chunk is then merged into an empty chunk, and the original
+/// chunk into that one, which must not add any types. Returns the number of differences.
+static size_t runImage(const char* scenario, const BenchTypes* types, const SwtiChunk* expected,
+                       const int* expectedIndices, BenchArena* arena)
+{
+    size_t count = types->count;
+    size_t octetCount = swtiChunkImageOctetCount(expected);
+    uint8_t* octets = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, uint8_t, octetCount);
+    FldOutStream out;
+    fldOutStreamInit(&out, octets, octetCount);
+    double start = nowSeconds();
+    if (swtiChunkImageWrite(expected, &out) < 0) {
+        return 1;
+    }
+    report(scenario, count, "imageWrite", expected->typeCount, nowSeconds() - start, expected->typeCount);
+
+    SwtiChunkImage image;
+    SwtiChunk chunk;
+    if (swtiChunkImageInit(&image, octets, out.pos) < 0 || swtiChunkInitFromImage(&chunk, &image, &arena->info) < 0) {
+        return 1;
+    }
+
+    size_t differences = chunk.typeCount != expected->typeCount;
+    start = nowSeconds();
+    for (size_t i = 0; i < count; ++i) {
+        differences += swtiChunkFindDeep(&chunk, types->roots[i]) != expectedIndices[i];
+    }
+    report(scenario, count, "imageFindDeep", count, nowSeconds() - start, chunk.typeCount);
+
+    if (types->names != 0) {
+        for (size_t i = 0; i < count; ++i) {
+            differences += swtiChunkFindFromName(&chunk, types->names[i]) != expectedIndices[i];
+        }
+    }
+    for (size_t i = 0; i < expected->typeCount; ++i) {
+        differences += swtiChunkUnaliasIndex(&chunk, i) != swtiChunkUnaliasIndex(expected, i);
+    }
+    differences += checkRecordFields(&chunk, expected);
+
+    SwtiChunk merged;
+    swtiChunkInitWithCapacity(&merged, expected->typeCount, &arena->info);
+    int* remap = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, int, expected->typeCount);
+    start = nowSeconds();
+    if (swtiChunkMerge(&merged, &chunk, remap, &arena->info) < 0) {
+        return differences + 1;
+    }
+    report(scenario, count, "merge", chunk.typeCount, nowSeconds() - start, merged.typeCount);
+    for (size_t i = 0; i < expected->typeCount; ++i) {
+        differences += swtiTypeEqual(merged.types[remap[i]], expected->types[i]) != 0;
+    }
+    size_t mergedCount = merged.typeCount;
+    differences += swtiChunkMerge(&merged, expected, remap, &arena->info) < 0 || merged.typeCount != mergedCount;
+
+    swtiChunkDestroy(&merged);
+    swtiChunkDestroy(&chunk);
+
+    return differences;
+}
+
+static int runScenario(const BenchScenario* scenario, size_t count)
+{
+    BenchArena arena;
+    arenaInit(&arena);
+
+    BenchTypes types;
+    scenario->generate(&arena, count, &types);
+
+    SwtiChunk chunk;
+    swtiChunkInitWithCapacity(&chunk, count, &arena.info);
+
+    int* indices = IMPRINT_ALLOC_TYPE_COUNT(&arena.info, int, count);
+    double start = nowSeconds();
+    for (size_t i = 0; i < count; ++i) {
+        indices[i] = swtiChunkAddType(&chunk, types.roots[i], &arena.info);
+        if (indices[i] < 0) {
+            fprintf(stderr, "bench: %s could not add type %zu\n", scenario->name, i);
+            arenaDestroy(&arena);
+            return indices[i];
+        }
+    }
+    report(scenario->name, count, "addType", count, nowSeconds() - start, chunk.typeCount);
+
+    // swtiChunkFind() only compares hashes, so with enough types some lookups find an earlier type with the same hash
+    size_t hashCollisions = 0;
+    start = nowSeconds();
+    for (size_t i = 0; i < count; ++i) {
+        hashCollisions += swtiChunkFind(&chunk, chunk.types[indices[i]]) != indices[i];
+    }
+    report(scenario->name, count, "find", count, nowSeconds() - start, chunk.typeCount);
+    if (hashCollisions > 0) {
+        fprintf(stderr, "bench: %s had %zu hash collisions in find\n", scenario->name, hashCollisions);
+    }
+
+    size_t misses = runBuilder(scenario->name, &types, &chunk, indices, &arena);
+    misses += runImage(scenario->name, &types, &chunk, indices, &arena);
+
+    start = nowSeconds();
+    for (size_t i = 0; i < count; ++i) {
+        misses += swtiChunkFindDeep(&chunk, types.roots[i]) < 0;
+    }
+    report(scenario->name, count, "findDeep", count, nowSeconds() - start, chunk.typeCount);
+
+    if (types.names != 0) {
+        start = nowSeconds();
+        for (size_t i = 0; i < count; ++i) {
+            misses += swtiChunkFindFromName(&chunk, types.names[i]) < 0;
+        }
+        report(scenario->name, count, "findFromName", count, nowSeconds() - start, chunk.typeCount);
+    }
+
+    start = nowSeconds();
+    for (size_t i = 0; i < count; ++i) {
+        misses += swtiTypeEqual(types.roots[i], chunk.types[indices[i]]) != 0;
+    }
+    report(scenario->name, count, "typeEqual", count, nowSeconds() - start, chunk.typeCount);
+
+    size_t totalSize = 0;
+    start = nowSeconds();
+    for (size_t i = 0; i < chunk.typeCount; ++i) {
+        totalSize += swtiChunkMemoryInfo(&chunk, i).memorySize;
+    }
+    report(scenario->name, count, "chunkMemoryInfo", chunk.typeCount, nowSeconds() - start, chunk.typeCount);
+
+    start = nowSeconds();
+    for (size_t i = 0; i < chunk.typeCount; ++i) {
+        totalSize += swtiChunkUnaliasIndex(&chunk, i);
+    }
+    report(scenario->name, count, "unaliasIndex", chunk.typeCount, nowSeconds() - start, chunk.typeCount);
+
+    start = nowSeconds();
+    for (size_t i = 0; i < count; ++i) {
+        totalSize += swtiGetMemorySize(types.roots[i]);
+    }
+    report(scenario->name, count, "getMemorySize", count, nowSeconds() - start, chunk.typeCount);
+
+    start = nowSeconds();
+    misses += swtiChunkFreeze(&chunk) < 0;
+    report(scenario->name, count, "freeze", chunk.typeCount, nowSeconds() - start, chunk.typeCount);
+
+    swtiChunkDestroy(&chunk);
+    arenaDestroy(&arena);
+
+    if (misses > 0) {
+        fprintf(stderr, "bench: %s had %zu failed lookups (checksum %zu)\n", scenario->name, misses, totalSize);
+        return -1;
+    }
+
+    return 0;
+}
+
+/// The List value in the value checks, the slot holds a pointer to it.
+typedef struct BenchList {
+    const void* items;
+    size_t count;
+} BenchList;
+
+/// The record value in the value checks, { a : Int, s : String, l : List Int }.
+typedef struct BenchValue {
+    int32_t a;
+    const char* s;
+    const BenchList* l;
+} BenchValue;
+
+static int benchOctets(void* userData, const void* slot, const uint8_t** octets, size_t* octetCount)
+{
+    const char* str = *(const char* const*) slot;
+    *octets = (const uint8_t*) str;
+    *octetCount = strlen(str) + 1;
+
+    return 0;
+}
+
+static int benchItems(void* userData, const void* slot, const void** items, size_t* itemCount)
+{
+    const BenchList* list = *(const BenchList* const*) slot;
+    *items = list->items;
+    *itemCount = list->count;
+
+    return 0;
+}
+
+static int benchBuildOctets(void* userData, const SwtiValueStep* step, void* slot, const uint8_t* octets,
+                            size_t octetCount)
+{
+    BenchArena* arena = (BenchArena*) userData;
+    char* str = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, char, octetCount);
+    memcpy(str, octets, octetCount);
+    *(const char**) slot = str;
+
+    return 0;
+}
+
+static int benchBuildItems(void* userData, const SwtiValueStep* step, void* slot, size_t itemCount, void** items)
+{
+    BenchArena* arena = (BenchArena*) userData;
+    BenchList* list = IMPRINT_ALLOC_TYPE(&arena->info, BenchList);
+    *items = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, int32_t, itemCount + 1);
+    list->items = *items;
+    list->count = itemCount;
+    *(const BenchList**) slot = list;
+
+    return 0;
+}
+
+static int benchCopyReference(void* userData, const SwtiValueStep* step, void* targetSlot, const void* sourceSlot)
+{
+    *(const void**) targetSlot = *(const void* const*) sourceSlot;
+
+    return 0;
+}
+
+static void benchScanReference(void* userData, void* slot)
+{
+    (*(size_t*) userData)++;
+}
+
+/// Packs and unpacks a record with a String and a List, and checks that the result is equal to the original, both
+/// in equality and hash, and that copies and the pointer map agree. Returns the number of differences.
+static size_t checkValues(BenchArena* arena)
+{
+    SwtiStringType* stringType = IMPRINT_ALLOC_TYPE(&arena->info, SwtiStringType);
+    swtiInitString(stringType);
+    SwtiListType* listType = IMPRINT_ALLOC_TYPE(&arena->info, SwtiListType);
+    swtiInitList(listType);
+    listType->itemType = &g_intType.internal;
+
+    SwtiRecordTypeField fields[3];
+    fieldInit(&fields[0], &g_intType.internal, "a", 0);
+    fields[0].memoryOffsetInfo.memoryInfo.memorySize = 4;
+    fields[0].memoryOffsetInfo.memoryInfo.memoryAlign = 4;
+    fieldInit(&fields[1], &stringType->internal, "s", offsetof(BenchValue, s));
+    fieldInit(&fields[2], &listType->internal, "l", offsetof(BenchValue, l));
+    SwtiRecordType* record = IMPRINT_ALLOC_TYPE(&arena->info, SwtiRecordType);
+    swtiInitRecordWithFields(record, fields, 3, &arena->info);
+    record->memoryInfo.memorySize = sizeof(BenchValue);
+    record->memoryInfo.memoryAlign = 8;
+
+    SwtiChunk chunk;
+    swtiChunkInitWithCapacity(&chunk, 0, &arena->info);
+    int recordIndex = swtiChunkAddType(&chunk, &record->internal, &arena->info);
+    if (recordIndex < 0) {
+        return 1;
+    }
+
+    int32_t numbers[3] = {1, 2, 3};
+    BenchList list = {numbers, 3};
+    BenchValue value;
+    // Garbage in the padding must not end up in the packed octets
+    memset(&value, 0xcd, sizeof(value));
+    value.a = 42;
+    value.s = "hello";
+    value.l = &list;
+
+    SwtiValueAccessor accessor = {0, benchOctets, benchItems};
+    uint8_t octets[256];
+    FldOutStream out;
+    fldOutStreamInit(&out, octets, sizeof(octets));
+    SwtiPackWriter writer;
+    swtiPackWriterInit(&writer, &chunk, &out, &accessor, 0, 0);
+    if (swtiPackWriterWrite(&writer, (size_t) recordIndex, &value) < 0) {
+        return 1;
+    }
+
+    SwtiValueBuilder builder = {arena, benchBuildOctets, benchBuildItems};
+    FldInStream in;
+    fldInStreamInit(&in, octets, out.pos);
+    SwtiPackReader reader;
+    swtiPackReaderInit(&reader, &chunk, &in, &builder);
+    BenchValue unpacked;
+    if (swtiPackReaderRead(&reader, (size_t) recordIndex, &unpacked) < 0) {
+        return 1;
+    }
+
+    size_t differences = in.pos != out.pos;
+    differences += swtiChunkValueEqual(&chunk, (size_t) recordIndex, &value, &unpacked, &accessor) != 1;
+    uint32_t hash;
+    uint32_t unpackedHash;
+    differences += swtiChunkValueHash(&chunk, (size_t) recordIndex, &value, &accessor, &hash) < 0;
+    differences += swtiChunkValueHash(&chunk, (size_t) recordIndex, &unpacked, &accessor, &unpackedHash) < 0;
+    differences += hash != unpackedHash;
+
+    SwtiValueCopier copier = {0, benchCopyReference};
+    BenchValue copy;
+    differences += swtiChunkValueCopy(&chunk, (size_t) recordIndex, &copy, &unpacked, &copier) < 0;
+    differences += swtiChunkValueEqual(&chunk, (size_t) recordIndex, &copy, &value, &accessor) != 1;
+
+    size_t referenceCount = 0;
+    differences += swtiChunkScanReferences(&chunk, (size_t) recordIndex, &copy, benchScanReference,
+                                           &referenceCount) < 0;
+    differences += referenceCount != 2;
+
+    swtiChunkDestroy(&chunk);
+
+    return differences;
+}
+
+/// Freezes a chunk with Tree = Leaf | Node (List Tree), built with swtiChunkInit(), which must not recurse
+/// forever on the cycle. Returns the number of differences.
+static size_t checkRecursiveFreeze(BenchArena* arena)
+{
+    SwtiCustomType* tree = IMPRINT_ALLOC_TYPE(&arena->info, SwtiCustomType);
+    SwtiListType* list = IMPRINT_ALLOC_TYPE(&arena->info, SwtiListType);
+    swtiInitList(list);
+    list->itemType = &tree->internal;
+
+    SwtiCustomTypeVariant* variants = IMPRINT_ALLOC_TYPE_COUNT(&arena->info, SwtiCustomTypeVariant, 2);
+    SwtiCustomTypeVariantField field;
+    field.fieldType = &list->internal;
+    field.memoryOffsetInfo.memoryOffset = 8;
+    field.memoryOffsetInfo.memoryInfo.memorySize = 8;
+    field.memoryOffsetInfo.memoryInfo.memoryAlign = 8;
+    swtiInitVariant(&variants[0], 0, 0, &arena->info);
+    variants[0].name = "Leaf";
+    variants[0].memoryInfo.memorySize = 1;
+    variants[0].memoryInfo.memoryAlign = 1;
+    swtiInitVariant(&variants[1], &field, 1, &arena->info);
+    ((SwtiCustomTypeVariantField*) variants[1].fields)[0].fieldType = field.fieldType;
+    variants[1].name = "Node";
+    variants[1].memoryInfo.memorySize = 16;
+    variants[1].memoryInfo.memoryAlign = 8;
+    swtiInitCustom(tree, "Tree", variants, 2, &arena->info);
+    tree->memoryInfo.memorySize = 16;
+    tree->memoryInfo.memoryAlign = 8;
+    variants[0].inCustomType = tree;
+    variants[1].inCustomType = tree;
+
+    SwtiType* types[2] = {&tree->internal, &list->internal};
+    SwtiChunk chunk;
+    if (swtiChunkInit(&chunk, types, 2, &arena->info) < 0) {
+        return 1;
+    }
+
+    size_t differences = swtiChunkFreeze(&chunk) < 0;
+    differences += swtiChunkDebugTypeString(&chunk, 0) == 0 || swtiChunkDebugTypeString(&chunk, 1) == 0;
+    differences += swtiChunkFindFromName(&chunk, "Tree") != 0;
+
+    swtiChunkDestroy(&chunk);
+
+    return differences;
+}
+
+/***
+ * Usage: swamp_typeinfo_bench [maxTypeCount] [scenario]
+ * Runs every scenario (or only the named one) for 1k types, then ten times as many up to maxTypeCount
+ * (default 100k, use 1000000 for the full run). Results are written to stdout as JSON lines.
+ */
+int main(int argc, const char* argv[])
+{
+    g_clog.log = clog_console;
+
+    size_t maxCount = argc > 1 ? (size_t) strtoull(argv[1], 0, 10) : 100000;
+    const char* only = argc > 2 ? argv[2] : 0;
+
+    swtiInitInt(&g_intType);
+
+    BenchArena arena;
+    arenaInit(&arena);
+    size_t differences = checkValues(&arena) + checkRecursiveFreeze(&arena);
+    arenaDestroy(&arena);
+    int result = 0;
+    if (differences > 0) {
+        fprintf(stderr, "bench: the value and freeze checks had %zu differences\n", differences);
+        result = 1;
+    }
+
+    for (size_t s = 0; s < sizeof(g_scenarios) / sizeof(g_scenarios[0]); ++s) {
+        const BenchScenario* scenario = &g_scenarios[s];
+        if (only != 0 && strcmp(only, scenario->name) != 0) {
+            continue;
+        }
+        for (size_t count = 1000; count <= maxCount; count *= 10) {
+            if (runScenario(scenario, count) < 0) {
+                result = 1;
+            }
+        }
+    }
+
+    return result;
+}
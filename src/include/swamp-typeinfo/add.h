@@ -9,6 +9,25 @@ struct SwtiChunk;
 struct SwtiType;
 struct ImprintAllocator;
 
+#include <stddef.h>
+#include <stdint.h>
+
+/***
+ * Tells swtiChunkAddTypesResolved() what is already known about a source type.
+ * @param userData
+ * @param type the source type.
+ * @param hash receives the structural hash of the type.
+ * @return a key that is the same for all equal source types, or negative if the type is unknown.
+ */
+typedef int (*SwtiAddResolve)(void* userData, const struct SwtiType* type, uint32_t* hash);
+
 int swtiChunkAddType(struct SwtiChunk* target, const struct SwtiType* source, struct ImprintAllocator* allocator);
+int swtiChunkAddTypes(struct SwtiChunk* target, const struct SwtiType* const* roots, size_t rootCount, int* indices,
+                      struct ImprintAllocator* allocator);
+int swtiChunkAddTypesResolved(struct SwtiChunk* target, const struct SwtiType* const* roots, size_t rootCount,
+                              int* indices, SwtiAddResolve resolve, void* resolveUserData, int* keyIndices,
+                              struct ImprintAllocator* allocator);
+int swtiChunkMerge(struct SwtiChunk* target, const struct SwtiChunk* source, int* remap,
+                   struct ImprintAllocator* allocator);
 
 #endif
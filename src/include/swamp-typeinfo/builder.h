@@ -0,0 +1,65 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_BUILDER_H
+#define SWAMP_TYPEINFO_BUILDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <swamp-typeinfo/equal.h>
+#include <swamp-typeinfo/hash.h>
+#include <swamp-typeinfo/visited.h>
+
+#define SWTI_CHUNK_BUILDER_DEFAULT_SHARD_COUNT (64)
+#define SWTI_CHUNK_BUILDER_EQUAL_CACHE_CAPACITY (256)
+
+struct SwtiType;
+struct SwtiChunk;
+struct SwtiChunkBuilderShard;
+struct SwtiChunkBuilderWorker;
+struct ImprintAllocator;
+
+/***
+ * Builds a chunk from root types that are added from several threads at the same time.
+ * The workers hash the source type graphs and deduplicate them in a table that is split into shards by hash,
+ * each shard with its own lock. That is where almost all of the time goes when adding types.
+ * swtiChunkBuilderFinish() then adds the roots to the chunk in root index order, reusing the hashes and the
+ * deduplication from the workers, so the chunk gets exactly the same types and type indices as if the roots had
+ * been added with swtiChunkAddTypes().
+ * Like the chunk, the builder allocates from ImprintAllocators and never frees, so the allocators must outlive it.
+ */
+typedef struct SwtiChunkBuilder {
+    struct ImprintAllocator* allocator;
+    struct SwtiChunkBuilderShard* shards;
+    size_t shardCount;
+    const struct SwtiType** roots;
+    const struct SwtiChunkBuilderWorker** rootWorkers;
+    size_t rootCount;
+} SwtiChunkBuilder;
+
+/***
+ * The state for one thread that adds types to the builder. Each thread must use its own worker.
+ * visited maps each source type that the worker has seen to its key in the builder, and remembers their hashes.
+ * allocator is only used from the thread of the worker.
+ */
+typedef struct SwtiChunkBuilderWorker {
+    SwtiChunkBuilder* builder;
+    struct ImprintAllocator* allocator;
+    SwtiTypeVisited visited;
+    SwtiTypeHashMemo hashMemo;
+    SwtiTypeEqualCache equalCache;
+    SwtiTypeEqualCacheEntry equalCacheEntries[SWTI_CHUNK_BUILDER_EQUAL_CACHE_CAPACITY];
+} SwtiChunkBuilderWorker;
+
+int swtiChunkBuilderInit(SwtiChunkBuilder* self, size_t rootCount, size_t shardCount,
+                         struct ImprintAllocator* allocator);
+void swtiChunkBuilderDestroy(SwtiChunkBuilder* self);
+int swtiChunkBuilderFinish(SwtiChunkBuilder* self, struct SwtiChunk* target, int* indices,
+                           struct ImprintAllocator* allocator);
+
+void swtiChunkBuilderWorkerInit(SwtiChunkBuilderWorker* self, SwtiChunkBuilder* builder,
+                                struct ImprintAllocator* allocator);
+int swtiChunkBuilderAdd(SwtiChunkBuilderWorker* self, size_t rootIndex, const struct SwtiType* root);
+
+#endif
@@ -6,31 +6,100 @@
 #define SWAMP_TYPEINFO_CHUNK_H
 
 #include <stdlib.h>
+#include <swamp-typeinfo/debug.h>
+#include <swamp-typeinfo/diagnostics.h>
+#include <swamp-typeinfo/hash.h>
+#include <swamp-typeinfo/intern.h>
+#include <swamp-typeinfo/stats.h>
+#include <swamp-typeinfo/visited.h>
 
 struct SwtiType;
+struct SwtiMemoryInfo;
+struct SwtiRecordFieldIndex;
+struct SwtiCustomVariantTable;
+struct SwtiValuePlan;
+struct SwtiPointerMap;
 struct ImprintAllocator;
+struct SwtiChunkImage;
+struct SwtiTypeEqualCache;
 
 /***
  * Holds information for all the types for the package.
+ * kinds, hashes and nameHashes are dense arrays in type index order, so lookups can reject candidates without
+ * touching (or materializing) the types. layouts holds the resolved size and alignment for each type and
+ * unaliased the index of the type that is left when all aliases are resolved.
+ * fieldIndices holds the field name index for each record and variantTables the variant tables for each custom
+ * type (null for other types). valuePlans and copyPlans cache the compiled value and copy plans
+ * (see value.h) and pointerMaps the offsets of the managed references (see pointer_map.h). Types that can not get a
+ * plan or map cache an internal "none" value, so always read them through the getters.
+ * debugStrings caches the debug output for each type.
+ * diagnostics counts what went wrong in lookups, lookups never log (see diagnostics.h). Like the lazily built
+ * tables it is reached through a pointer, so lookups on a const chunk can count without casting away const. It is
+ * only null if the chunk could not be initialized.
+ * addVisited is the scratch map for the types that are added to the chunk (see add.h), it is reused between the adds.
+ * A frozen chunk (see swtiChunkFreeze()) is immutable and can be read from any number of threads, all the functions
+ * that read from a chunk take it as const.
+ * When built with SWTI_CHUNK_STATS the chunk counts its lookups and allocations in stats (see stats.h). The
+ * allocator then points to the counting allocator inside the chunk, so the chunk must not be moved after it is
+ * initialized.
  */
 typedef struct SwtiChunk {
     const struct SwtiType** types;
     size_t typeCount;
     size_t maxCount;
+    uint8_t* kinds;
+    struct SwtiMemoryInfo* layouts;
+    uint32_t* unaliased;
+    const struct SwtiRecordFieldIndex** fieldIndices;
+    const struct SwtiCustomVariantTable** variantTables;
+    const struct SwtiValuePlan** valuePlans;
+    const struct SwtiValuePlan** copyPlans;
+    const struct SwtiPointerMap** pointerMaps;
+    const char** debugStrings;
+    uint32_t* hashes;
+    SwtiHashIndex hashIndex;
+    uint32_t* nameHashes;
+    SwtiHashIndex nameIndex;
+    SwtiStringTable strings;
+    struct ImprintAllocator* allocator;
+    const struct SwtiChunkImage* image;
+    SwtiChunkDiagnostics* diagnostics;
+    SwtiTypeVisited addVisited;
+    int frozen;
+#if SWTI_CHUNK_STATS
+    SwtiChunkStats* stats;
+    SwtiCountingAllocator countingAllocator;
+#endif
 } SwtiChunk;
 
-void swtiChunkInit(SwtiChunk* self, const struct SwtiType** types, size_t typeCount, struct ImprintAllocator* allocator);
+int swtiChunkInit(SwtiChunk* self, struct SwtiType** types, size_t typeCount, struct ImprintAllocator* allocator);
+int swtiChunkInitWithCapacity(SwtiChunk* self, size_t capacityHint, struct ImprintAllocator* allocator);
+int swtiChunkReserve(SwtiChunk* self, size_t capacity);
+int swtiChunkInitFromImage(SwtiChunk* self, const struct SwtiChunkImage* image, struct ImprintAllocator* allocator);
 void swtiChunkDestroy(SwtiChunk* self);
+int swtiChunkFreeze(SwtiChunk* self);
 
 int swtiChunkFind(const SwtiChunk* self, const struct SwtiType* type);
 int swtiChunkFindDeep(const SwtiChunk* self, const struct SwtiType* typeToSearchFor);
+int swtiChunkFindDeepWithHash(const SwtiChunk* self, const struct SwtiType* typeToSearchFor, uint32_t hash,
+                              struct SwtiTypeEqualCache* cache);
 int swtiChunkFindFromName(const SwtiChunk* self, const char* typeToSearchFor);
 const struct SwtiType* swtiChunkTypeFromIndex(const SwtiChunk* self, size_t index);
+const struct SwtiType* swtiChunkMaterialize(const SwtiChunk* self, size_t index);
 const struct SwtiType* swtiChunkGetFromName(const SwtiChunk* self, const char* typeToSearchFor);
+struct SwtiMemoryInfo swtiChunkMemoryInfo(const SwtiChunk* self, size_t index);
+size_t swtiChunkUnaliasIndex(const SwtiChunk* self, size_t index);
+const struct SwtiType* swtiChunkUnalias(const SwtiChunk* self, const struct SwtiType* maybeAlias);
 
+int swtiChunkInsert(SwtiChunk* self, const struct SwtiType* type);
+int swtiChunkBuildTypeTables(const SwtiChunk* self, size_t index);
 int swtiChunkCopy(const SwtiChunk* self, const struct SwtiType* type);
 int swtiChunkInitOnlyOneType(SwtiChunk* self, const struct SwtiType *rootType, int* index, struct ImprintAllocator* allocator);
+int swtiChunkInitOnlyOneTypeWithCapacity(SwtiChunk* self, const struct SwtiType* rootType, int* index, size_t capacityHint,
+                                         struct ImprintAllocator* allocator);
 
+const char* swtiChunkDebugTypeString(const SwtiChunk* self, size_t index);
+int swtiChunkDebugWrite(const SwtiChunk* self, int flags, SwtiDebugSink sink, void* userData);
 void swtiChunkDebugOutput(const SwtiChunk* self, int flags, const char* debug);
 
 #endif
@@ -0,0 +1,43 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_CUSTOM_H
+#define SWAMP_TYPEINFO_CUSTOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <swamp-typeinfo/hash.h>
+#include <swamp-typeinfo/typeinfo.h>
+
+struct SwtiChunk;
+struct ImprintAllocator;
+
+/***
+ * The memory layout of a variant. The tag of a variant is its index in SwtiCustomType::variantTypes.
+ */
+typedef struct SwtiVariantLayout {
+    const SwtiCustomTypeVariant* variant;
+    SwtiMemoryInfo memoryInfo;
+    size_t fieldCount;
+    const SwtiMemoryOffsetInfo* fieldOffsets;
+} SwtiVariantLayout;
+
+/***
+ * Finds the variants of a custom type from their names or tags without scanning all the variants.
+ */
+typedef struct SwtiCustomVariantTable {
+    uint32_t* nameHashes;
+    SwtiHashIndex nameIndex;
+    SwtiVariantLayout* layouts;
+    size_t variantCount;
+} SwtiCustomVariantTable;
+
+int swtiCustomVariantTableInit(SwtiCustomVariantTable* self, const SwtiCustomType* custom,
+                               struct ImprintAllocator* allocator);
+int swtiCustomVariantTableFind(const SwtiCustomVariantTable* self, const char* name);
+
+int swtiChunkFindVariant(const struct SwtiChunk* self, size_t customIndex, const char* name);
+const SwtiVariantLayout* swtiChunkVariantLayout(const struct SwtiChunk* self, size_t customIndex, size_t tag);
+
+#endif
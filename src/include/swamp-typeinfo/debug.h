@@ -0,0 +1,54 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_DEBUG_H
+#define SWAMP_TYPEINFO_DEBUG_H
+
+#include <stddef.h>
+#include <swamp-typeinfo/typeinfo.h>
+
+#define SWTI_DEBUG_WRITER_BUFFER_SIZE (256)
+
+/***
+ * Receives debug output. The text is not zero terminated.
+ * @return negative on error, which stops the output.
+ */
+typedef int (*SwtiDebugSink)(void* userData, const char* text, size_t length);
+
+/***
+ * The types that are being written, from the innermost and out. Lives on the stack of swtiDebugWriterWriteType().
+ */
+typedef struct SwtiDebugWriterParent {
+    const SwtiType* type;
+    const struct SwtiDebugWriterParent* parent;
+} SwtiDebugWriterParent;
+
+/***
+ * parents is used to detect types that refer back to themselves, they are written as a back reference.
+ */
+typedef struct SwtiDebugWriter {
+    char* buffer;
+    size_t bufferSize;
+    size_t pos;
+    SwtiDebugSink sink;
+    void* userData;
+    int error;
+    const SwtiDebugWriterParent* parents;
+} SwtiDebugWriter;
+
+void swtiDebugWriterInit(SwtiDebugWriter* self, char* buffer, size_t bufferSize, SwtiDebugSink sink, void* userData);
+void swtiDebugWriterWrite(SwtiDebugWriter* self, const char* text, size_t length);
+void swtiDebugWriterWrites(SwtiDebugWriter* self, const char* text);
+void swtiDebugWriterWritef(SwtiDebugWriter* self, const char* format, ...);
+void swtiDebugWriterWriteType(SwtiDebugWriter* self, SwtiDebugOutputFlags flags, const SwtiType* type);
+int swtiDebugWriterFlush(SwtiDebugWriter* self);
+
+int swtiDebugWrite(SwtiDebugSink sink, void* userData, SwtiDebugOutputFlags flags, const SwtiType* type);
+
+/***
+ * A sink that writes to the FILE* that is passed as userData.
+ */
+int swtiDebugFileSink(void* userData, const char* text, size_t length);
+
+#endif
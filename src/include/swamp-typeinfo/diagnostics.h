@@ -0,0 +1,48 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_DIAGNOSTICS_H
+#define SWAMP_TYPEINFO_DIAGNOSTICS_H
+
+#include <stdint.h>
+
+struct SwtiChunk;
+
+typedef enum SwtiChunkDiagnostic {
+    SwtiChunkDiagnosticKindCollision, // swtiChunkFind() found a type with the same hash but another kind
+    SwtiChunkDiagnosticNameMiss,      // swtiChunkGetFromName() did not find the name
+    SwtiChunkDiagnosticKindMismatch   // A variant or field was looked up in a type that is not a custom type or record
+} SwtiChunkDiagnostic;
+
+/***
+ * Called for each diagnostic. index is the colliding type index for kind collisions, the type index that has the
+ * wrong kind for kind mismatches and -1 for name misses. name is the name of the type, or the name that was searched
+ * for, and is only valid during the call. It can be null for kind mismatches.
+ */
+typedef void (*SwtiChunkDiagnosticHook)(void* userData, const struct SwtiChunk* chunk, SwtiChunkDiagnostic diagnostic,
+                                        int index, const char* name);
+
+/***
+ * Lookups never log, they only count what went wrong and remember the last offender. Install a hook to get
+ * notified, swtiChunkDiagnosticLogHook() logs each diagnostic.
+ */
+typedef struct SwtiChunkDiagnostics {
+    uint32_t kindCollisionCount;
+    uint32_t nameMissCount;
+    uint32_t kindMismatchCount;
+    int lastCollisionIndex;
+    int lastMismatchIndex;
+    uint32_t lastMissNameHash;
+    SwtiChunkDiagnosticHook hook;
+    void* hookUserData;
+} SwtiChunkDiagnostics;
+
+void swtiChunkDiagnosticsInit(SwtiChunkDiagnostics* self);
+void swtiChunkDiagnosticsReport(const struct SwtiChunk* chunk, SwtiChunkDiagnostic diagnostic, int index,
+                                const char* name);
+void swtiChunkSetDiagnosticHook(struct SwtiChunk* self, SwtiChunkDiagnosticHook hook, void* userData);
+void swtiChunkDiagnosticLogHook(void* userData, const struct SwtiChunk* chunk, SwtiChunkDiagnostic diagnostic,
+                                int index, const char* name);
+
+#endif
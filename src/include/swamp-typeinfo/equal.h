@@ -5,8 +5,37 @@
 #ifndef SWAMP_TYPEINFO_DEEP_EQUAL_H
 #define SWAMP_TYPEINFO_DEEP_EQUAL_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <swamp-typeinfo/stats.h>
+
 struct SwtiType;
 
+typedef struct SwtiTypeEqualCacheEntry {
+    const struct SwtiType* a;
+    const struct SwtiType* b;
+    int result;
+} SwtiTypeEqualCacheEntry;
+
+/***
+ * Remembers the result of earlier comparisons between pairs of types.
+ */
+typedef struct SwtiTypeEqualCache {
+    SwtiTypeEqualCacheEntry* entries;
+    size_t capacity;
+    size_t hitCount;
+    size_t missCount;
+#if SWTI_CHUNK_STATS
+    uint64_t callCount;
+    uint64_t depth;
+    uint64_t maxDepth;
+#endif
+} SwtiTypeEqualCache;
+
 int swtiTypeEqual(const struct SwtiType* a, const struct SwtiType* b);
+int swtiTypeEqualCached(const struct SwtiType* a, const struct SwtiType* b, SwtiTypeEqualCache* cache);
+
+void swtiTypeEqualCacheInit(SwtiTypeEqualCache* self, SwtiTypeEqualCacheEntry* entries, size_t capacity);
+void swtiTypeEqualCacheClear(SwtiTypeEqualCache* self);
 
 #endif
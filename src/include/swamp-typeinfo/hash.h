@@ -0,0 +1,53 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_HASH_H
+#define SWAMP_TYPEINFO_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct SwtiType;
+struct SwtiChunk;
+struct ImprintAllocator;
+
+/***
+ * Open addressing (linear probing) index from a 32-bit hash to a value (normally a type index).
+ * The hashes are not stored in the slots, they are looked up in a caller provided keys array, indexed by value.
+ */
+typedef struct SwtiHashIndex {
+    uint32_t* slots;
+    size_t capacity;
+    size_t count;
+} SwtiHashIndex;
+
+typedef struct SwtiHashIndexProbe {
+    size_t slot;
+    uint32_t hash;
+} SwtiHashIndexProbe;
+
+/***
+ * Remembers the structural hashes of types that are not contained in a chunk, so a type graph that is hashed again
+ * and again (e.g. the source types when adding to a chunk) is only walked once.
+ * find returns the remembered hash, or zero if not known. store is only called for types that are not on a cycle.
+ */
+typedef struct SwtiTypeHashMemo {
+    uint32_t (*find)(void* userData, const struct SwtiType* type);
+    void (*store)(void* userData, const struct SwtiType* type, uint32_t hash);
+    void* userData;
+} SwtiTypeHashMemo;
+
+uint32_t swtiTypeHash(const struct SwtiType* type);
+uint32_t swtiChunkTypeHash(struct SwtiChunk* chunk, const struct SwtiType* type);
+uint32_t swtiChunkTypeHashWithMemo(struct SwtiChunk* chunk, const struct SwtiType* type, const SwtiTypeHashMemo* memo);
+uint16_t swtiTypeHashFold(uint32_t hash);
+uint32_t swtiStringHash(const char* str);
+
+void swtiHashIndexInit(SwtiHashIndex* self);
+int swtiHashIndexReserve(SwtiHashIndex* self, const uint32_t* keys, size_t count, struct ImprintAllocator* allocator);
+int swtiHashIndexInsert(SwtiHashIndex* self, const uint32_t* keys, uint32_t value, struct ImprintAllocator* allocator);
+void swtiHashIndexProbeInit(SwtiHashIndexProbe* probe, const SwtiHashIndex* self, uint32_t hash);
+int swtiHashIndexProbeNext(SwtiHashIndexProbe* probe, const SwtiHashIndex* self, const uint32_t* keys);
+
+#endif
@@ -0,0 +1,116 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_IMAGE_H
+#define SWAMP_TYPEINFO_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <swamp-typeinfo/hash.h>
+
+struct SwtiChunk;
+struct SwtiType;
+struct SwtiMemoryInfo;
+struct FldOutStream;
+
+#define SWTI_IMAGE_MAGIC (0x49545753)
+#define SWTI_IMAGE_VERSION (4)
+#define SWTI_IMAGE_NONE (0xffffffff)
+
+/***
+ * A serialized chunk that is used in place (e.g. memory mapped) without any allocations or pointer fixups.
+ * All offsets are relative to the start of the image and all type references are type indices.
+ * Sections are eight byte aligned and stored in native byte order.
+ * The kinds section duplicates SwtiImageEntry::type as one octet per type and the layouts section holds the
+ * resolved size and alignment for each type (aliases resolved) and the unaliased section the index that is left
+ * when all aliases are resolved, so a chunk can use them in place without touching the entries.
+ */
+typedef struct SwtiImageHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entrySize;
+    uint32_t typeCount;
+    uint32_t itemCount;
+    uint32_t stringsSize;
+    uint32_t hashSlotCapacity;
+    uint32_t nameSlotCapacity;
+    uint32_t entriesOffset;
+    uint32_t hashesOffset;
+    uint32_t nameHashesOffset;
+    uint32_t hashSlotsOffset;
+    uint32_t nameSlotsOffset;
+    uint32_t itemsOffset;
+    uint32_t stringsOffset;
+    uint32_t octetCount;
+    uint32_t kindsOffset;
+    uint32_t layoutsOffset;
+    uint32_t unaliasedOffset;
+} SwtiImageHeader;
+
+/***
+ * One entry per type index.
+ * target is the alias target, the list or array item type, the referenced type or the unmanaged user type id.
+ * The items are the record fields, tuple fields, function parameters or custom type variants.
+ */
+typedef struct SwtiImageEntry {
+    uint8_t type;
+    uint8_t memoryAlign;
+    uint16_t memorySize;
+    uint32_t name;
+    uint32_t firstItem;
+    uint32_t itemCount;
+    uint32_t target;
+} SwtiImageEntry;
+
+/***
+ * A field, parameter or variant.
+ * ref is a type index, except for variants where it is the item index of the first variant field.
+ * count is only used for variants and holds the number of variant fields.
+ */
+typedef struct SwtiImageItem {
+    uint32_t ref;
+    uint32_t name;
+    uint16_t count;
+    uint16_t memoryOffset;
+    uint16_t memorySize;
+    uint8_t memoryAlign;
+    uint8_t reserved;
+} SwtiImageItem;
+
+typedef struct SwtiChunkImage {
+    const uint8_t* octets;
+    size_t octetCount;
+    const SwtiImageHeader* header;
+    const SwtiImageEntry* entries;
+    const uint32_t* hashes;
+    const uint32_t* nameHashes;
+    const uint8_t* kinds;
+    const struct SwtiMemoryInfo* layouts;
+    const uint32_t* unaliased;
+    const SwtiImageItem* items;
+    const char* strings;
+    SwtiHashIndex hashIndex;
+    SwtiHashIndex nameIndex;
+    void* mapping;
+    size_t mappingSize;
+} SwtiChunkImage;
+
+size_t swtiChunkImageOctetCount(const struct SwtiChunk* chunk);
+int swtiChunkImageWrite(const struct SwtiChunk* chunk, struct FldOutStream* out);
+
+int swtiChunkImageInit(SwtiChunkImage* self, const void* octets, size_t octetCount);
+int swtiChunkImageMapFile(SwtiChunkImage* self, const char* filename);
+void swtiChunkImageDestroy(SwtiChunkImage* self);
+
+size_t swtiChunkImageTypeCount(const SwtiChunkImage* self);
+const SwtiImageEntry* swtiChunkImageEntry(const SwtiChunkImage* self, size_t index);
+const SwtiImageItem* swtiChunkImageItems(const SwtiChunkImage* self, const SwtiImageEntry* entry);
+const SwtiImageItem* swtiChunkImageVariantFields(const SwtiChunkImage* self, const SwtiImageItem* variant);
+const char* swtiChunkImageString(const SwtiChunkImage* self, uint32_t offset);
+int swtiChunkImageFind(const SwtiChunkImage* self, const struct SwtiType* type);
+int swtiChunkImageFindFromName(const SwtiChunkImage* self, const char* name);
+uint32_t swtiChunkImageUnaliasIndex(const SwtiChunkImage* self, size_t index);
+int swtiChunkImageMemoryInfo(const SwtiChunkImage* self, size_t index, struct SwtiMemoryInfo* out);
+
+#endif
@@ -0,0 +1,32 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_INTERN_H
+#define SWAMP_TYPEINFO_INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <swamp-typeinfo/hash.h>
+
+struct ImprintAllocator;
+
+/***
+ * Holds one copy of each distinct string. The strings and the table are allocated from the allocator and
+ * are never freed individually, so two interned strings are equal if and only if the pointers are equal.
+ */
+typedef struct SwtiStringTable {
+    const char** strings;
+    uint32_t* hashes;
+    size_t count;
+    size_t capacity;
+    SwtiHashIndex index;
+    struct ImprintAllocator* allocator;
+} SwtiStringTable;
+
+void swtiStringTableInit(SwtiStringTable* self, struct ImprintAllocator* allocator);
+const char* swtiStringTableIntern(SwtiStringTable* self, const char* str);
+const char* swtiStringTableFind(const SwtiStringTable* self, const char* str);
+const char* swtiStrDup(struct ImprintAllocator* allocator, const char* str);
+
+#endif
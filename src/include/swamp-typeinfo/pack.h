@@ -0,0 +1,64 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_PACK_H
+#define SWAMP_TYPEINFO_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct SwtiChunk;
+struct SwtiValueAccessor;
+struct SwtiValueStep;
+struct FldOutStream;
+struct FldInStream;
+
+/***
+ * Called when the out stream is full (and by swtiPackWriterFlush). Octets that do not fit in the out stream at all
+ * are handed over directly, without being copied to the stream first.
+ */
+typedef int (*SwtiPackFlush)(void* userData, const uint8_t* octets, size_t octetCount);
+
+/***
+ * Packs values by walking their value plans. The fields with plain data are written as is, in the memory layout of
+ * the host, and each String and Blob is written as an octet count followed by the octets and each List and Array as
+ * an item count followed by the packed items. Custom values are written as the tag followed by the fields of the
+ * active variant. Padding is never written, so equal values always pack to the same octets.
+ */
+typedef struct SwtiPackWriter {
+    const struct SwtiChunk* chunk;
+    struct FldOutStream* out;
+    const struct SwtiValueAccessor* accessor;
+    SwtiPackFlush flush;
+    void* flushUserData;
+} SwtiPackWriter;
+
+/***
+ * Creates the managed values when unpacking. octets is called for String and Blob slots and items for List and
+ * Array slots. items must store a reference in the slot and return storage for itemCount items, each
+ * swtiChunkValueStride() octets, that is then filled in by the reader.
+ */
+typedef struct SwtiValueBuilder {
+    void* userData;
+    int (*octets)(void* userData, const struct SwtiValueStep* step, void* slot, const uint8_t* octets,
+                  size_t octetCount);
+    int (*items)(void* userData, const struct SwtiValueStep* step, void* slot, size_t itemCount, void** items);
+} SwtiValueBuilder;
+
+typedef struct SwtiPackReader {
+    const struct SwtiChunk* chunk;
+    struct FldInStream* in;
+    const SwtiValueBuilder* builder;
+} SwtiPackReader;
+
+void swtiPackWriterInit(SwtiPackWriter* self, const struct SwtiChunk* chunk, struct FldOutStream* out,
+                        const struct SwtiValueAccessor* accessor, SwtiPackFlush flush, void* flushUserData);
+int swtiPackWriterWrite(SwtiPackWriter* self, size_t typeIndex, const void* value);
+int swtiPackWriterFlush(SwtiPackWriter* self);
+
+void swtiPackReaderInit(SwtiPackReader* self, const struct SwtiChunk* chunk, struct FldInStream* in,
+                        const SwtiValueBuilder* builder);
+int swtiPackReaderRead(SwtiPackReader* self, size_t typeIndex, void* value);
+
+#endif
@@ -0,0 +1,43 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_POINTER_MAP_H
+#define SWAMP_TYPEINFO_POINTER_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <swamp-typeinfo/typeinfo.h>
+
+struct SwtiChunk;
+
+/***
+ * A custom value inside a value that has managed references in at least one of its variants.
+ */
+typedef struct SwtiPointerMapCustom {
+    SwtiMemoryOffset offset;
+    uint32_t typeIndex;
+} SwtiPointerMapCustom;
+
+/***
+ * The offsets of all the managed references (String, Blob, List and Array) in a value, with nested records and
+ * tuples flattened. Offsets are relative to the start of the value and sorted.
+ * Custom values that can hold references are listed in customs, and the map for the custom type itself has one map
+ * per variant, indexed by tag.
+ */
+typedef struct SwtiPointerMap {
+    const SwtiMemoryOffset* offsets;
+    size_t offsetCount;
+    const SwtiPointerMapCustom* customs;
+    size_t customCount;
+    const struct SwtiPointerMap* const* variantMaps;
+    size_t variantCount;
+} SwtiPointerMap;
+
+typedef void (*SwtiPointerMapVisit)(void* userData, void* slot);
+
+const SwtiPointerMap* swtiChunkPointerMap(const struct SwtiChunk* self, size_t typeIndex);
+int swtiChunkScanReferences(const struct SwtiChunk* self, size_t typeIndex, void* value, SwtiPointerMapVisit visit,
+                            void* userData);
+
+#endif
@@ -0,0 +1,32 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_RECORD_H
+#define SWAMP_TYPEINFO_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <swamp-typeinfo/hash.h>
+
+struct SwtiChunk;
+struct SwtiRecordType;
+struct SwtiMemoryOffsetInfo;
+struct ImprintAllocator;
+
+/***
+ * Finds record fields from their names without scanning all the fields.
+ */
+typedef struct SwtiRecordFieldIndex {
+    uint32_t* nameHashes;
+    SwtiHashIndex index;
+} SwtiRecordFieldIndex;
+
+int swtiRecordFieldIndexInit(SwtiRecordFieldIndex* self, const struct SwtiRecordType* record,
+                             struct ImprintAllocator* allocator);
+int swtiRecordFieldIndexFind(const SwtiRecordFieldIndex* self, const struct SwtiRecordType* record, const char* name);
+
+int swtiChunkFindRecordField(const struct SwtiChunk* self, size_t recordIndex, const char* name,
+                             struct SwtiMemoryOffsetInfo* out);
+
+#endif
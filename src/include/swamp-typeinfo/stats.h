@@ -0,0 +1,77 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_STATS_H
+#define SWAMP_TYPEINFO_STATS_H
+
+#include <imprint/allocator.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Enable with -DSWTI_CHUNK_STATS=1 (the SWTI_CHUNK_STATS CMake option). When disabled the counters are not part of
+// the chunk and all the updates compile to nothing.
+#if !defined SWTI_CHUNK_STATS
+#define SWTI_CHUNK_STATS 0
+#endif
+
+struct SwtiChunk;
+
+#define SWTI_STATS_KIND_COUNT (32)
+
+/***
+ * Counters for a chunk. Lookups are counted per kind of the type that is searched for, and the probe length is the
+ * number of hash index candidates that had to be checked. The counters are not thread safe.
+ */
+typedef struct SwtiChunkStats {
+    uint64_t findCount[SWTI_STATS_KIND_COUNT];
+    uint64_t findDeepCount[SWTI_STATS_KIND_COUNT];
+    uint64_t findNameCount;
+    uint64_t probeCount;
+    uint64_t maxProbeLength;
+    uint64_t addDedupHitCount;
+    uint64_t addDedupMissCount;
+    uint64_t equalCallCount;
+    uint64_t equalMaxDepth;
+    uint64_t allocationCount;
+    uint64_t allocatedOctetCount;
+} SwtiChunkStats;
+
+/***
+ * Forwards to another allocator and counts the allocations.
+ */
+typedef struct SwtiCountingAllocator {
+    ImprintAllocator info;
+    ImprintAllocator* parent;
+    SwtiChunkStats* stats;
+} SwtiCountingAllocator;
+
+void swtiCountingAllocatorInit(SwtiCountingAllocator* self, ImprintAllocator* parent, SwtiChunkStats* stats);
+
+void swtiChunkStats(const struct SwtiChunk* self, SwtiChunkStats* out);
+void swtiChunkStatsReset(struct SwtiChunk* self);
+
+#if SWTI_CHUNK_STATS
+// Frozen chunks are shared between threads, so they are not counted
+#define SWTI_CHUNK_STATS_ADD(chunk, field, value)                                                                      \
+    do {                                                                                                               \
+        if (!(chunk)->frozen && (chunk)->stats != 0) {                                                                 \
+            (chunk)->stats->field += (value);                                                                          \
+        }                                                                                                              \
+    } while (0)
+#define SWTI_CHUNK_STATS_MAX(chunk, field, value)                                                                      \
+    do {                                                                                                               \
+        uint64_t statsValue_ = (uint64_t) (value);                                                                     \
+        if (!(chunk)->frozen && (chunk)->stats != 0 && statsValue_ > (chunk)->stats->field) {                          \
+            (chunk)->stats->field = statsValue_;                                                                       \
+        }                                                                                                              \
+    } while (0)
+#define SWTI_CHUNK_STATS_KIND(chunk, field, kind)                                                                      \
+    SWTI_CHUNK_STATS_ADD(chunk, field[(size_t) (kind) % SWTI_STATS_KIND_COUNT], 1)
+#else
+#define SWTI_CHUNK_STATS_ADD(chunk, field, value) ((void) 0)
+#define SWTI_CHUNK_STATS_MAX(chunk, field, value) ((void) 0)
+#define SWTI_CHUNK_STATS_KIND(chunk, field, kind) ((void) 0)
+#endif
+
+#endif
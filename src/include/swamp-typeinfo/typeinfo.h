@@ -45,8 +45,8 @@ typedef uint8_t SwtiMemoryAlign;
 
 typedef struct SwtiType {
     SwtiTypeValue type;
-    uint16_t hash;
-    uint16_t index;
+    uint16_t hash; // Folded structural hash (see swtiTypeHashFold()). Zero if not calculated yet or on a cycle.
+    uint32_t index;
     const char* name;
 } SwtiType;
 
@@ -209,6 +209,7 @@ const SwtiListType* swtiList(const SwtiType* maybeAlias);
 const SwtiRecordType* swtiRecord(const SwtiType* maybeRecord);
 SwtiMemoryAlign swtiGetMemoryAlign(const SwtiType* type);
 SwtiMemorySize swtiGetMemorySize(const SwtiType* type);
+int swtiGetMemoryInfo(const SwtiType* type, SwtiMemoryInfo* out);
 
 int swtiVerifyMemoryInfo(const SwtiMemoryInfo* info);
 int swtiVerifyMemoryOffsetInfo(const SwtiMemoryOffsetInfo* info);
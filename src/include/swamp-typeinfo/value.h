@@ -0,0 +1,80 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_VALUE_H
+#define SWAMP_TYPEINFO_VALUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <swamp-typeinfo/typeinfo.h>
+
+struct SwtiChunk;
+
+typedef enum SwtiValueStepKind {
+    SwtiValueStepBlock, // Plain data, compared, hashed and copied as octets
+    SwtiValueStepString,
+    SwtiValueStepBlob,
+    SwtiValueStepList,
+    SwtiValueStepArray,
+    SwtiValueStepCustom, // A one octet tag followed by the fields of the variant with that tag
+    SwtiValueStepUnmanaged // Compared and hashed as octets, but copied as a reference
+} SwtiValueStepKind;
+
+/***
+ * A single step in a value plan. Offsets are relative to the start of the value.
+ * typeIndex is the item type for lists and arrays and the custom type for custom steps.
+ */
+typedef struct SwtiValueStep {
+    uint8_t kind;
+    SwtiMemoryOffset offset;
+    SwtiMemorySize size;
+    uint32_t typeIndex;
+} SwtiValueStep;
+
+/***
+ * How a value of a type is laid out in memory, flattened into steps. Adjacent plain data fields are folded into
+ * a single block step and nested records and tuples are inlined.
+ * Plans for custom types have one plan per variant, indexed by tag.
+ * In copy plans the blocks are blits that also cover the padding, and all other steps are references, except
+ * custom steps for custom types that contain references.
+ */
+typedef struct SwtiValuePlan {
+    const SwtiValueStep* steps;
+    size_t stepCount;
+    SwtiMemoryInfo memoryInfo;
+    const struct SwtiValuePlan* const* variantPlans;
+    size_t variantCount;
+} SwtiValuePlan;
+
+/***
+ * Gives access to the managed values that the type information does not describe the memory layout for.
+ * A slot is where the String, Blob, List or Array reference is stored in the containing value.
+ */
+typedef struct SwtiValueAccessor {
+    void* userData;
+    int (*octets)(void* userData, const void* slot, const uint8_t** octets, size_t* octetCount);
+    int (*items)(void* userData, const void* slot, const void** items, size_t* itemCount);
+} SwtiValueAccessor;
+
+/***
+ * Copies the managed value (String, Blob, List, Array or Unmanaged) that is referenced from a slot.
+ * The step kind tells what kind of reference it is and the step type index is the item type for lists and arrays.
+ */
+typedef struct SwtiValueCopier {
+    void* userData;
+    int (*copyReference)(void* userData, const SwtiValueStep* step, void* targetSlot, const void* sourceSlot);
+} SwtiValueCopier;
+
+const SwtiValuePlan* swtiChunkValuePlan(const struct SwtiChunk* self, size_t typeIndex);
+const SwtiValuePlan* swtiChunkCopyPlan(const struct SwtiChunk* self, size_t typeIndex);
+size_t swtiChunkValueStride(const struct SwtiChunk* self, size_t typeIndex);
+
+int swtiChunkValueEqual(const struct SwtiChunk* self, size_t typeIndex, const void* a, const void* b,
+                        const SwtiValueAccessor* accessor);
+int swtiChunkValueHash(const struct SwtiChunk* self, size_t typeIndex, const void* value,
+                       const SwtiValueAccessor* accessor, uint32_t* outHash);
+int swtiChunkValueCopy(const struct SwtiChunk* self, size_t typeIndex, void* target, const void* source,
+                       const SwtiValueCopier* copier);
+
+#endif
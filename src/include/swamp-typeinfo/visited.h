@@ -0,0 +1,39 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef SWAMP_TYPEINFO_VISITED_H
+#define SWAMP_TYPEINFO_VISITED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct SwtiType;
+struct SwtiTypeHashMemo;
+struct ImprintAllocator;
+
+/***
+ * Maps the source types that a type graph walk has seen to a value (-1 if not set), so shared sub graphs are only
+ * walked once. Also remembers the structural hashes of the types (zero if not known), see swtiTypeVisitedHashMemo().
+ * The table is allocated from the allocator and is never freed, like the rest of the allocations in a chunk, so it is
+ * cleared (see swtiTypeVisitedClear()) and reused between walks. A slot is only in use if its generation is the
+ * current one, that way clearing does not have to touch the table.
+ */
+typedef struct SwtiTypeVisited {
+    const struct SwtiType** keys;
+    int* values;
+    uint32_t* hashes;
+    uint32_t* generations;
+    size_t capacity;
+    size_t count;
+    uint32_t generation;
+    struct ImprintAllocator* allocator;
+} SwtiTypeVisited;
+
+void swtiTypeVisitedInit(SwtiTypeVisited* self, struct ImprintAllocator* allocator);
+void swtiTypeVisitedClear(SwtiTypeVisited* self);
+int swtiTypeVisitedFind(const SwtiTypeVisited* self, const struct SwtiType* type);
+int swtiTypeVisitedInsert(SwtiTypeVisited* self, const struct SwtiType* type, int value);
+void swtiTypeVisitedHashMemo(SwtiTypeVisited* self, struct SwtiTypeHashMemo* memo);
+
+#endif
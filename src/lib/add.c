@@ -6,18 +6,84 @@
 #include <imprint/allocator.h>
 #include <swamp-typeinfo/add.h>
 #include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/equal.h>
+#include <swamp-typeinfo/hash.h>
 #include <swamp-typeinfo/typeinfo.h>
+#include <swamp-typeinfo/visited.h>
+
+#define SWTI_ADD_EQUAL_CACHE_CAPACITY (256)
+
+typedef struct SwtiAddContext {
+    SwtiChunk* target;
+    const SwtiChunk* source;
+    ImprintAllocator* allocator;
+    SwtiTypeVisited* visited;
+    SwtiTypeHashMemo hashMemo;
+    SwtiAddResolve resolve;
+    void* resolveUserData;
+    int* keyIndices;
+    SwtiTypeEqualCache equalCache;
+    SwtiTypeEqualCacheEntry equalCacheEntries[SWTI_ADD_EQUAL_CACHE_CAPACITY];
+#if SWTI_CHUNK_STATS
+    SwtiCountingAllocator countingAllocator;
+#endif
+} SwtiAddContext;
+
+/// Allocations for the copied types are counted in the target chunk, unless they already go through its allocator
+static ImprintAllocator* contextAllocator(SwtiAddContext* self, ImprintAllocator* allocator)
+{
+#if SWTI_CHUNK_STATS
+    if (allocator != self->target->allocator && self->target->stats != 0) {
+        swtiCountingAllocatorInit(&self->countingAllocator, allocator, self->target->stats);
+        return &self->countingAllocator.info;
+    }
+#endif
+
+    return allocator;
+}
+
+/// The visited map is the scratch map of the target chunk, so it is only allocated once per chunk
+static void contextInit(SwtiAddContext* self, SwtiChunk* target, const SwtiChunk* source, ImprintAllocator* allocator)
+{
+    self->target = target;
+    self->source = source;
+    self->allocator = contextAllocator(self, allocator);
+    self->visited = &target->addVisited;
+    swtiTypeVisitedClear(self->visited);
+    swtiTypeVisitedHashMemo(self->visited, &self->hashMemo);
+    self->resolve = 0;
+    self->resolveUserData = 0;
+    self->keyIndices = 0;
+    swtiTypeEqualCacheInit(&self->equalCache, self->equalCacheEntries, SWTI_ADD_EQUAL_CACHE_CAPACITY);
+}
 
-static int addType(SwtiChunk* target, const SwtiType* source, const SwtiType** out, ImprintAllocator* allocator);
+static int addType(SwtiAddContext* context, const SwtiType* source, const SwtiType** out, ImprintAllocator* allocator);
 
-static int addTypes(SwtiChunk* target, const SwtiType** source, const SwtiType*** out, size_t count, ImprintAllocator* allocator)
+static int findDeep(SwtiAddContext* context, const SwtiType* type)
+{
+    const SwtiChunk* sourceChunk = context->source;
+    uint32_t hash;
+    if (sourceChunk != 0 && type->index < sourceChunk->typeCount && sourceChunk->types[type->index] == type &&
+        sourceChunk->hashes[type->index] != 0) {
+        // The source chunk already knows the structural hash, no need to walk the type graph again
+        hash = sourceChunk->hashes[type->index];
+    } else {
+        // Each source type is only walked once, the hashes of the sub types are remembered in the visited map
+        hash = swtiChunkTypeHashWithMemo(context->target, type, &context->hashMemo);
+    }
+
+    // The sub types of a matching candidate are compared again when they are added, the cache makes that a lookup
+    return swtiChunkFindDeepWithHash(context->target, type, hash, &context->equalCache);
+}
+
+static int addTypes(SwtiAddContext* context, const SwtiType** source, const SwtiType*** out, size_t count, ImprintAllocator* allocator)
 {
     int error;
     *out = 0;
     const SwtiType** targetArray = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiType*, count);
 
     for (size_t i = 0; i < count; ++i) {
-        if ((error = addType(target, source[i], &targetArray[i], allocator)) < 0) {
+        if ((error = addType(context, source[i], &targetArray[i], allocator)) < 0) {
             return error;
         }
     }
@@ -27,35 +93,40 @@ static int addTypes(SwtiChunk* target, const SwtiType** source, const SwtiType**
     return 0;
 }
 
-static int addCustomTypeVariant(SwtiChunk* target, const SwtiCustomTypeVariant* source, SwtiCustomTypeVariant* out, ImprintAllocator* allocator)
+static int addCustomTypeVariant(SwtiAddContext* context, const SwtiCustomTypeVariant* source, const SwtiCustomType* inCustomType, const SwtiCustomTypeVariant** out, ImprintAllocator* allocator)
 {
-    out->paramCount = source->paramCount;
-    out->name = tc_str_dup(source->name);
-    out->fields = IMPRINT_CALLOC_TYPE_COUNT(allocator, SwtiCustomTypeVariantField, out->paramCount);
+    SwtiCustomTypeVariant* variant = IMPRINT_ALLOC_TYPE(allocator, SwtiCustomTypeVariant);
+    swtiInitVariant(variant, source->fields, source->paramCount, allocator);
+    variant->name = swtiStringTableIntern(&context->target->strings, source->name);
+    variant->inCustomType = inCustomType;
+    variant->memoryInfo = source->memoryInfo;
+    *out = variant;
 
-    for (size_t i=0; i<out->paramCount; ++i) {
-        addType(target, source->fields[i].fieldType, (const SwtiType**) &out->fields[i].fieldType, allocator);
-        ((SwtiCustomTypeVariantField*)&out->fields[i])->memoryOffsetInfo.memoryOffset = source->fields[i].memoryOffsetInfo.memoryOffset;
+    int error;
+    for (size_t i=0; i<variant->paramCount; ++i) {
+        if ((error = addType(context, source->fields[i].fieldType, (const SwtiType**) &variant->fields[i].fieldType, allocator)) < 0) {
+            return error;
+        }
     }
 
     return 0;
 }
 
-static int addCustomType(SwtiChunk* target, const SwtiCustomType* source, const SwtiCustomType** out, ImprintAllocator* allocator)
+static int addCustomType(SwtiAddContext* context, const SwtiCustomType* source, const SwtiCustomType** out, ImprintAllocator* allocator)
 {
     SwtiCustomType* custom = IMPRINT_ALLOC_TYPE(allocator, SwtiCustomType);
-    swtiInitCustom(custom, tc_str_dup(source->internal.name), 0, 0, allocator);
+    swtiInitCustom(custom, swtiStringTableIntern(&context->target->strings, source->internal.name), 0, 0, allocator);
 
     custom->variantTypes = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiCustomTypeVariant*, source->variantCount);
     custom->variantCount = source->variantCount;
+    custom->memoryInfo = source->memoryInfo;
 
 
     *out = custom;
 
     int error;
     for (size_t i = 0; i < source->variantCount; ++i) {
-        if ((error = addCustomTypeVariant(target, source->variantTypes[i],
-                                          (SwtiCustomTypeVariant*) &custom->variantTypes[i], allocator)) != 0) {
+        if ((error = addCustomTypeVariant(context, source->variantTypes[i], custom, &custom->variantTypes[i], allocator)) < 0) {
             return error;
         }
     }
@@ -63,45 +134,47 @@ static int addCustomType(SwtiChunk* target, const SwtiCustomType* source, const
     return 0;
 }
 
-static int addUnmanaged(SwtiChunk* target, const SwtiUnmanagedType* source, const SwtiUnmanagedType** out, ImprintAllocator* allocator)
+static int addUnmanaged(SwtiAddContext* context, const SwtiUnmanagedType* source, const SwtiUnmanagedType** out, ImprintAllocator* allocator)
 {
     SwtiUnmanagedType* unmanagedType = IMPRINT_ALLOC_TYPE(allocator, SwtiUnmanagedType);
-    swtiInitUnmanaged(unmanagedType, source->userTypeId, source->internal.name, allocator);
+    swtiInitUnmanaged(unmanagedType, source->userTypeId,
+                      swtiStringTableIntern(&context->target->strings, source->internal.name), allocator);
 
     *out = unmanagedType;
 
     return 0;
 }
 
-static int addFunction(SwtiChunk* target, const SwtiFunctionType* source, const SwtiFunctionType** out, ImprintAllocator* allocator)
+static int addFunction(SwtiAddContext* context, const SwtiFunctionType* source, const SwtiFunctionType** out, ImprintAllocator* allocator)
 {
     SwtiFunctionType* fn = IMPRINT_ALLOC_TYPE(allocator, SwtiFunctionType);
     swtiInitFunction(fn, source->parameterTypes, source->parameterCount, allocator);
     *out = fn;
 
-    return addTypes(target, source->parameterTypes, &fn->parameterTypes, source->parameterCount, allocator);
+    return addTypes(context, source->parameterTypes, &fn->parameterTypes, source->parameterCount, allocator);
 }
 
-static int addTupleField(SwtiChunk* target, const SwtiTupleTypeField* source, SwtiTupleTypeField* out, ImprintAllocator* allocator)
+static int addTupleField(SwtiAddContext* context, const SwtiTupleTypeField* source, SwtiTupleTypeField* out, ImprintAllocator* allocator)
 {
     if (!source->name) {
         CLOG_ERROR("name must be set")
     }
-    out->name = tc_str_dup(source->name);
+    out->name = swtiStringTableIntern(&context->target->strings, source->name);
     out->memoryOffsetInfo = source->memoryOffsetInfo;
-    return addType(target, source->fieldType, &out->fieldType, allocator);
+    return addType(context, source->fieldType, &out->fieldType, allocator);
 }
 
-static int addTuple(SwtiChunk* target, const SwtiTupleType* source, const SwtiTupleType** out, ImprintAllocator* allocator)
+static int addTuple(SwtiAddContext* context, const SwtiTupleType* source, const SwtiTupleType** out, ImprintAllocator* allocator)
 {
     SwtiTupleType* tuple = IMPRINT_ALLOC_TYPE(allocator, SwtiTupleType);
+    swtiInitTuple(tuple, 0, 0, allocator);
     tuple->fields = IMPRINT_CALLOC_TYPE_COUNT(allocator, SwtiTupleTypeField, source->fieldCount);
     tuple->fieldCount = source->fieldCount;
     tuple->memoryInfo = source->memoryInfo;
 
     int error;
     for (size_t i = 0; i < source->fieldCount; ++i) {
-        if ((error = addTupleField(target, &source->fields[i], (struct SwtiTupleTypeField*) &tuple->fields[i], allocator)) < 0) {
+        if ((error = addTupleField(context, &source->fields[i], (struct SwtiTupleTypeField*) &tuple->fields[i], allocator)) < 0) {
             *out = 0;
             return error;
         }
@@ -111,31 +184,32 @@ static int addTuple(SwtiChunk* target, const SwtiTupleType* source, const SwtiTu
     return 0;
 }
 
-static int addAlias(SwtiChunk* target, const SwtiAliasType* source, const SwtiAliasType** out, ImprintAllocator* allocator)
+static int addAlias(SwtiAddContext* context, const SwtiAliasType* source, const SwtiAliasType** out, ImprintAllocator* allocator)
 {
     SwtiAliasType* alias = IMPRINT_ALLOC_TYPE(allocator, SwtiAliasType);
-    swtiInitAlias(alias, source->internal.name, 0);
+    swtiInitAlias(alias, swtiStringTableIntern(&context->target->strings, source->internal.name), 0);
     *out = alias;
-    return addType(target, source->targetType, &alias->targetType, allocator);
+    return addType(context, source->targetType, &alias->targetType, allocator);
 }
 
-static int addRecordField(SwtiChunk* target, const SwtiRecordTypeField* source, SwtiRecordTypeField* out, ImprintAllocator* allocator)
+static int addRecordField(SwtiAddContext* context, const SwtiRecordTypeField* source, SwtiRecordTypeField* out, ImprintAllocator* allocator)
 {
-    out->name = tc_str_dup(source->name);
+    out->name = swtiStringTableIntern(&context->target->strings, source->name);
     out->memoryOffsetInfo = source->memoryOffsetInfo;
-    return addType(target, source->fieldType, &out->fieldType, allocator);
+    return addType(context, source->fieldType, &out->fieldType, allocator);
 }
 
-static int addRecord(SwtiChunk* target, const SwtiRecordType* source, const SwtiRecordType** out, ImprintAllocator* allocator)
+static int addRecord(SwtiAddContext* context, const SwtiRecordType* source, const SwtiRecordType** out, ImprintAllocator* allocator)
 {
     SwtiRecordType* record = IMPRINT_ALLOC_TYPE(allocator, SwtiRecordType);
     swtiInitRecord(record);
     record->fields = IMPRINT_CALLOC_TYPE_COUNT(allocator, SwtiRecordTypeField, source->fieldCount);
     record->fieldCount = source->fieldCount;
+    record->memoryInfo = source->memoryInfo;
 
     int error;
     for (size_t i = 0; i < source->fieldCount; ++i) {
-        if ((error = addRecordField(target, &source->fields[i], (struct SwtiRecordTypeField*) &record->fields[i], allocator)) < 0) {
+        if ((error = addRecordField(context, &source->fields[i], (struct SwtiRecordTypeField*) &record->fields[i], allocator)) < 0) {
             *out = 0;
             return error;
         }
@@ -145,36 +219,61 @@ static int addRecord(SwtiChunk* target, const SwtiRecordType* source, const Swti
     return 0;
 }
 
-static int addArray(SwtiChunk* target, const SwtiArrayType* source, const SwtiArrayType** out, ImprintAllocator* allocator)
+static int addArray(SwtiAddContext* context, const SwtiArrayType* source, const SwtiArrayType** out, ImprintAllocator* allocator)
 {
     SwtiArrayType* array = IMPRINT_ALLOC_TYPE(allocator, SwtiArrayType);
     swtiInitArray(array);
     *out = array;
     array->memoryInfo = source->memoryInfo;
 
-    return addType(target, source->itemType, &array->itemType, allocator);
+    return addType(context, source->itemType, &array->itemType, allocator);
 }
 
-static int addList(SwtiChunk* target, const SwtiListType* source, const SwtiListType** out, ImprintAllocator* allocator)
+static int addList(SwtiAddContext* context, const SwtiListType* source, const SwtiListType** out, ImprintAllocator* allocator)
 {
     SwtiListType* list = IMPRINT_ALLOC_TYPE(allocator, SwtiListType);
     swtiInitList(list);
     *out = list;
     list->memoryInfo = source->memoryInfo;
-    return addType(target, source->itemType, &list->itemType, allocator);
+    return addType(context, source->itemType, &list->itemType, allocator);
 }
 
-static int addType(SwtiChunk* target, const SwtiType* source, const SwtiType** out, ImprintAllocator* allocator)
+/// Equal source types share a key, so a key that has been added once is never hashed or compared again
+static int findResolved(SwtiAddContext* context, int key, const SwtiType* type, uint32_t hash)
 {
-    int foundIndex = swtiChunkFindDeep(target, source);
-    if (foundIndex >= 0) {
-        *out = target->types[foundIndex];
-        return foundIndex;
+    int foundIndex = context->keyIndices[key];
+    if (foundIndex < 0) {
+        foundIndex = swtiChunkFindDeepWithHash(context->target, type, hash, &context->equalCache);
+        context->keyIndices[key] = foundIndex;
     }
 
-    if (target->typeCount == target->maxCount) {
-        return -3;
+    return foundIndex;
+}
+
+static int addType(SwtiAddContext* context, const SwtiType* source, const SwtiType** out, ImprintAllocator* allocator)
+{
+    SwtiChunk* target = context->target;
+
+    uint32_t resolvedHash;
+    int key = context->resolve != 0 ? context->resolve(context->resolveUserData, source, &resolvedHash) : -1;
+    int foundIndex;
+    if (key >= 0) {
+        foundIndex = findResolved(context, key, source, resolvedHash);
+    } else {
+        foundIndex = swtiTypeVisitedFind(context->visited, source);
+        if (foundIndex < 0) {
+            foundIndex = findDeep(context, source);
+            if (foundIndex >= 0 && swtiTypeVisitedInsert(context->visited, source, foundIndex) < 0) {
+                return -1;
+            }
+        }
     }
+    if (foundIndex >= 0) {
+        SWTI_CHUNK_STATS_ADD(target, addDedupHitCount, 1);
+        *out = swtiChunkTypeFromIndex(target, foundIndex);
+        return foundIndex;
+    }
+    SWTI_CHUNK_STATS_ADD(target, addDedupMissCount, 1);
 
     int error = -99;
 
@@ -183,44 +282,46 @@ static int addType(SwtiChunk* target, const SwtiType* source, const SwtiType** o
             SwtiAnyType* any = IMPRINT_ALLOC_TYPE(allocator, SwtiAnyType);
             swtiInitAny(any);
             *out = (const SwtiType*) any;
+            error = 0;
             break;
         }
         case SwtiTypeAnyMatchingTypes: {
             SwtiAnyMatchingTypesType* anyMatchingTypes = IMPRINT_ALLOC_TYPE(allocator, SwtiAnyMatchingTypesType);
             swtiInitAnyMatchingTypes(anyMatchingTypes);
             *out = (const SwtiType*) anyMatchingTypes;
+            error = 0;
             break;
         }
         case SwtiTypeCustom: {
-            error = addCustomType(target, (const SwtiCustomType*) source, (const SwtiCustomType**) out, allocator);
+            error = addCustomType(context, (const SwtiCustomType*) source, (const SwtiCustomType**) out, allocator);
             break;
         }
         case SwtiTypeFunction: {
-            error = addFunction(target, (const SwtiFunctionType*) source, (const SwtiFunctionType**) out, allocator);
+            error = addFunction(context, (const SwtiFunctionType*) source, (const SwtiFunctionType**) out, allocator);
             break;
         }
         case SwtiTypeTuple: {
-            error = addTuple(target, (const SwtiTupleType*) source, (const SwtiTupleType**) out, allocator);
+            error = addTuple(context, (const SwtiTupleType*) source, (const SwtiTupleType**) out, allocator);
             break;
         }
         case SwtiTypeAlias: {
-            error = addAlias(target, (const SwtiAliasType*) source, (const SwtiAliasType**) out, allocator);
+            error = addAlias(context, (const SwtiAliasType*) source, (const SwtiAliasType**) out, allocator);
             break;
         }
         case SwtiTypeRecord: {
-            error = addRecord(target, (const SwtiRecordType*) source, (const SwtiRecordType**) out, allocator);
+            error = addRecord(context, (const SwtiRecordType*) source, (const SwtiRecordType**) out, allocator);
             break;
         }
         case SwtiTypeArray: {
-            error = addArray(target, (const SwtiArrayType*) source, (const SwtiArrayType**) out, allocator);
+            error = addArray(context, (const SwtiArrayType*) source, (const SwtiArrayType**) out, allocator);
             break;
         }
         case SwtiTypeList: {
-            error = addList(target, (const SwtiListType*) source, (const SwtiListType**) out, allocator);
+            error = addList(context, (const SwtiListType*) source, (const SwtiListType**) out, allocator);
             break;
         }
         case SwtiTypeUnmanaged: {
-            error = addUnmanaged(target, (const SwtiUnmanagedType*) source, (const SwtiUnmanagedType**) out, allocator);
+            error = addUnmanaged(context, (const SwtiUnmanagedType*) source, (const SwtiUnmanagedType**) out, allocator);
             break;
         }
         case SwtiTypeString: {
@@ -280,15 +381,120 @@ static int addType(SwtiChunk* target, const SwtiType* source, const SwtiType** o
         return error;
     }
 
-    int newIndex = target->typeCount++;
-    ((SwtiType*) (*out))->index = newIndex;
-    target->types[newIndex] = *out;
+    int newIndex = swtiChunkInsert(target, *out);
+    if (key >= 0) {
+        context->keyIndices[key] = newIndex;
+    } else if (newIndex >= 0 && swtiTypeVisitedInsert(context->visited, source, newIndex) < 0) {
+        return -1;
+    }
 
     return newIndex;
 }
 
+/***
+ * Adds the roots to the target chunk in order, or all the types in the source chunk if roots is null.
+ * @param context
+ * @param name the public function, for the error messages.
+ * @param roots the types to add, or null to add the types in the source chunk.
+ * @param rootCount the number of types to add.
+ * @param indices receives the chunk index for each root.
+ * @return negative on error.
+ */
+static int addRoots(SwtiAddContext* context, const char* name, const SwtiType* const* roots, size_t rootCount,
+                    int* indices)
+{
+    if (context->target->frozen) {
+        CLOG_SOFT_ERROR("%s: chunk is frozen", name)
+        return -2;
+    }
+
+    for (size_t i = 0; i < rootCount; ++i) {
+        const SwtiType* root = roots != 0 ? roots[i] : swtiChunkTypeFromIndex(context->source, i);
+        if (root == 0) {
+            CLOG_SOFT_ERROR("%s: could not get type %zu from source chunk", name, i)
+            return -2;
+        }
+        const SwtiType* ignoreResult;
+        int result = addType(context, root, &ignoreResult, context->allocator);
+        if (result < 0) {
+            return result;
+        }
+        indices[i] = result;
+    }
+
+    return 0;
+}
+
 int swtiChunkAddType(SwtiChunk* target, const SwtiType* source, ImprintAllocator* allocator)
 {
-    const SwtiType* ignoreResult;
-    return addType(target, source, &ignoreResult, allocator);
+    int index;
+    int error;
+    if ((error = swtiChunkAddTypes(target, &source, 1, &index, allocator)) < 0) {
+        return error;
+    }
+
+    return index;
+}
+
+/***
+ * Adds several root types in one go. Sub graphs that are shared between the roots are only looked up once.
+ * @param target the chunk to add to.
+ * @param roots the types to add.
+ * @param rootCount the number of types in roots.
+ * @param indices receives the chunk index for each root, must have room for rootCount indices.
+ * @param allocator the allocator for the copied types.
+ * @return negative on error.
+ */
+int swtiChunkAddTypes(SwtiChunk* target, const SwtiType* const* roots, size_t rootCount, int* indices,
+                      ImprintAllocator* allocator)
+{
+    SwtiAddContext context;
+    contextInit(&context, target, 0, allocator);
+
+    return addRoots(&context, "swtiChunkAddTypes", roots, rootCount, indices);
+}
+
+/***
+ * Same as swtiChunkAddTypes(), but asks resolve for the structural hash and the key of each source type before it
+ * is looked up. All source types with the same key are added as the same type, without comparing them again.
+ * Used by the chunk builder (see builder.h), that has already hashed and deduplicated the source types.
+ * @param target the chunk to add to.
+ * @param roots the types to add.
+ * @param rootCount the number of types in roots.
+ * @param indices receives the chunk index for each root, must have room for rootCount indices.
+ * @param resolve returns the key for a source type, or negative if the type is unknown (it is then added as usual).
+ * @param resolveUserData passed on to resolve.
+ * @param keyIndices the chunk index for each key. Must be set to -1 before the first call, and can be passed to
+ * several calls with the same target chunk.
+ * @param allocator the allocator for the copied types.
+ * @return negative on error.
+ */
+int swtiChunkAddTypesResolved(SwtiChunk* target, const SwtiType* const* roots, size_t rootCount, int* indices,
+                              SwtiAddResolve resolve, void* resolveUserData, int* keyIndices,
+                              ImprintAllocator* allocator)
+{
+    SwtiAddContext context;
+    contextInit(&context, target, 0, allocator);
+    context.resolve = resolve;
+    context.resolveUserData = resolveUserData;
+    context.keyIndices = keyIndices;
+
+    return addRoots(&context, "swtiChunkAddTypesResolved", roots, rootCount, indices);
+}
+
+/***
+ * Merges all the types in the source chunk into the target chunk. Types that already exist in the target
+ * are reused, so the target only grows with the types that are new to it.
+ * @param target the chunk to merge into.
+ * @param source the chunk to merge from.
+ * @param remap receives the target index for each source index. Must have room for source->typeCount indices.
+ * @param allocator the allocator for the copied types.
+ * @return negative on error.
+ */
+int swtiChunkMerge(SwtiChunk* target, const SwtiChunk* source, int* remap, ImprintAllocator* allocator)
+{
+    SwtiAddContext context;
+    contextInit(&context, target, source, allocator);
+
+    return addRoots(&context, "swtiChunkMerge", 0, source->typeCount, remap);
 }
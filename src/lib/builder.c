@@ -0,0 +1,540 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <limits.h>
+#include <swamp-typeinfo/add.h>
+#include <swamp-typeinfo/builder.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/hash.h>
+#include <swamp-typeinfo/typeinfo.h>
+#if defined _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define SWTI_CHUNK_BUILDER_SHARD_MIN_CAPACITY (16)
+#define SWTI_CHUNK_BUILDER_CANDIDATE_CAPACITY (8)
+
+#if defined _WIN32
+typedef SRWLOCK SwtiChunkBuilderLock;
+#else
+typedef pthread_mutex_t SwtiChunkBuilderLock;
+#endif
+
+typedef struct SwtiChunkBuilderShardStorage {
+    const SwtiType** types;
+    uint32_t* hashes;
+    size_t capacity;
+    uint32_t* slots;
+    size_t slotCapacity;
+} SwtiChunkBuilderShardStorage;
+
+/***
+ * One part of the deduplication table, it holds the first source type that was seen for each distinct type
+ * with a hash that belongs to the shard. The key of a type is its index in the shard combined with the shard index.
+ * The entries are only added, never changed or removed. The lock is only held while probing and inserting, the
+ * types are compared and the storage is allocated without holding it.
+ */
+typedef struct SwtiChunkBuilderShard {
+    SwtiChunkBuilderLock lock;
+    SwtiChunkBuilderShardStorage storage;
+    size_t count;
+} SwtiChunkBuilderShard;
+
+/***
+ * The entries in a shard with the same hash as the type that is looked up, in index order.
+ * checkedCount is the number of entries in the shard that the candidates cover.
+ */
+typedef struct SwtiChunkBuilderCandidates {
+    uint32_t indices[SWTI_CHUNK_BUILDER_CANDIDATE_CAPACITY];
+    const SwtiType* types[SWTI_CHUNK_BUILDER_CANDIDATE_CAPACITY];
+    size_t count;
+    size_t checkedCount;
+} SwtiChunkBuilderCandidates;
+
+typedef struct SwtiChunkBuilderResolve {
+    const SwtiChunkBuilder* builder;
+    const SwtiChunkBuilderWorker* worker;
+    const size_t* shardBases;
+} SwtiChunkBuilderResolve;
+
+/// The low bits of the hash selects the shard, so they are mixed with the high bits
+static size_t hashSlot(uint32_t hash, size_t capacity)
+{
+    return (hash ^ (hash >> 16)) & (capacity - 1);
+}
+
+static void lockInit(SwtiChunkBuilderLock* lock)
+{
+#if defined _WIN32
+    InitializeSRWLock(lock);
+#else
+    pthread_mutex_init(lock, 0);
+#endif
+}
+
+static void lockDestroy(SwtiChunkBuilderLock* lock)
+{
+#if !defined _WIN32
+    pthread_mutex_destroy(lock);
+#endif
+}
+
+static void lockAcquire(SwtiChunkBuilderLock* lock)
+{
+#if defined _WIN32
+    AcquireSRWLockExclusive(lock);
+#else
+    pthread_mutex_lock(lock);
+#endif
+}
+
+static void lockRelease(SwtiChunkBuilderLock* lock)
+{
+#if defined _WIN32
+    ReleaseSRWLockExclusive(lock);
+#else
+    pthread_mutex_unlock(lock);
+#endif
+}
+
+static void storageInit(SwtiChunkBuilderShardStorage* self)
+{
+    self->types = 0;
+    self->hashes = 0;
+    self->capacity = 0;
+    self->slots = 0;
+    self->slotCapacity = 0;
+}
+
+/// The storage is never freed, the capacity doubles each time so at most half of the allocated storage is unused
+static int storageAllocate(SwtiChunkBuilderShardStorage* self, size_t capacity, ImprintAllocator* allocator)
+{
+    self->types = IMPRINT_ALLOC_TYPE_COUNT(allocator, const SwtiType*, capacity);
+    self->hashes = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint32_t, capacity);
+    // Twice the number of entries, to keep the load factor at or below 0.5
+    self->slots = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint32_t, capacity * 2);
+    if (self->types == 0 || self->hashes == 0 || self->slots == 0) {
+        storageInit(self);
+        return -1;
+    }
+    self->capacity = capacity;
+    self->slotCapacity = capacity * 2;
+
+    return 0;
+}
+
+static void shardInit(SwtiChunkBuilderShard* self)
+{
+    lockInit(&self->lock);
+    storageInit(&self->storage);
+    self->count = 0;
+}
+
+static void shardDestroy(SwtiChunkBuilderShard* self)
+{
+    storageInit(&self->storage);
+    lockDestroy(&self->lock);
+}
+
+/// Moves the entries to the larger storage, that then gets the storage of the shard. The previous storage is handed
+/// back in grown. Must be called with the lock held.
+static void shardMoveTo(SwtiChunkBuilderShard* self, SwtiChunkBuilderShardStorage* grown)
+{
+    if (self->count > 0) {
+        tc_memcpy_type_n(grown->types, self->storage.types, self->count);
+        tc_memcpy_type_n(grown->hashes, self->storage.hashes, self->count);
+    }
+
+    // Zero is reserved for empty slots
+    tc_mem_clear_type_n(grown->slots, grown->slotCapacity);
+    for (size_t i = 0; i < self->count; ++i) {
+        size_t slot = hashSlot(grown->hashes[i], grown->slotCapacity);
+        while (grown->slots[slot] != 0) {
+            slot = (slot + 1) & (grown->slotCapacity - 1);
+        }
+        grown->slots[slot] = (uint32_t) i + 1;
+    }
+
+    SwtiChunkBuilderShardStorage previous = self->storage;
+    self->storage = *grown;
+    *grown = previous;
+}
+
+/// Keeps the candidates with the lowest indices, the rest are collected again in the next round
+static void candidatesAdd(SwtiChunkBuilderCandidates* self, uint32_t index, const SwtiType* type)
+{
+    size_t position = self->count;
+    if (position == SWTI_CHUNK_BUILDER_CANDIDATE_CAPACITY) {
+        uint32_t highest = self->indices[position - 1];
+        uint32_t dropped = index > highest ? index : highest;
+        if (dropped < self->checkedCount) {
+            self->checkedCount = dropped;
+        }
+        if (index > highest) {
+            return;
+        }
+        position--;
+    } else {
+        self->count++;
+    }
+
+    while (position > 0 && self->indices[position - 1] > index) {
+        self->indices[position] = self->indices[position - 1];
+        self->types[position] = self->types[position - 1];
+        position--;
+    }
+    self->indices[position] = index;
+    self->types[position] = type;
+}
+
+/// Collects the entries with the same hash that have not been checked yet. Returns the empty slot that ended the
+/// probe. Must be called with the lock held.
+static size_t shardFindCandidates(const SwtiChunkBuilderShard* self, uint32_t hash,
+                                  SwtiChunkBuilderCandidates* candidates)
+{
+    const SwtiChunkBuilderShardStorage* storage = &self->storage;
+    size_t firstUnchecked = candidates->checkedCount;
+    candidates->count = 0;
+    candidates->checkedCount = self->count;
+    if (storage->slotCapacity == 0) {
+        return 0;
+    }
+
+    size_t slot = hashSlot(hash, storage->slotCapacity);
+    while (storage->slots[slot] != 0) {
+        uint32_t index = storage->slots[slot] - 1;
+        if (index >= firstUnchecked && storage->hashes[index] == hash) {
+            candidatesAdd(candidates, index, storage->types[index]);
+        }
+        slot = (slot + 1) & (storage->slotCapacity - 1);
+    }
+
+    return slot;
+}
+
+/// Returns the index in the shard of the type that is equal to type, it is added if it is not in the shard already.
+/// The candidates with the same hash are collected with the lock held, but compared after it has been released.
+/// Entries that were added by other threads in the meantime are collected and compared in the next round.
+/// A larger storage is allocated (from the allocator of the calling worker) without the lock held.
+static int shardFindOrInsert(SwtiChunkBuilderShard* self, const SwtiType* type, uint32_t hash,
+                             SwtiTypeEqualCache* equalCache, ImprintAllocator* allocator)
+{
+    SwtiChunkBuilderCandidates candidates;
+    candidates.checkedCount = 0;
+    SwtiChunkBuilderShardStorage spare;
+    storageInit(&spare);
+
+    int result = -1;
+    while (result < 0) {
+        lockAcquire(&self->lock);
+        if (spare.capacity > self->storage.capacity) {
+            shardMoveTo(self, &spare);
+        }
+
+        size_t slot = shardFindCandidates(self, hash, &candidates);
+        if (candidates.count == 0) {
+            if (self->count < self->storage.capacity) {
+                size_t index = self->count++;
+                self->storage.types[index] = type;
+                self->storage.hashes[index] = hash;
+                self->storage.slots[slot] = (uint32_t) index + 1;
+                lockRelease(&self->lock);
+                result = (int) index;
+                break;
+            }
+            size_t capacity = self->storage.capacity == 0 ? SWTI_CHUNK_BUILDER_SHARD_MIN_CAPACITY
+                                                          : self->storage.capacity * 2;
+            lockRelease(&self->lock);
+
+            // The spare can already be large enough, if another thread grew the shard before it was installed
+            if (spare.capacity < capacity && storageAllocate(&spare, capacity, allocator) < 0) {
+                break;
+            }
+            continue;
+        }
+        lockRelease(&self->lock);
+
+        for (size_t i = 0; i < candidates.count; ++i) {
+            if (swtiTypeEqualCached(candidates.types[i], type, equalCache) == 0) {
+                result = (int) candidates.indices[i];
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/***
+ * Prepares a builder for a known number of root types.
+ * @param self
+ * @param rootCount the number of root types that will be added.
+ * @param shardCount the number of shards in the deduplication table, rounded up to a power of two. Zero uses
+ * SWTI_CHUNK_BUILDER_DEFAULT_SHARD_COUNT. More shards means less waiting for the locks.
+ * @param allocator the allocator for the roots and the shards, and for the lookup tables in
+ * swtiChunkBuilderFinish(). The allocations are never freed.
+ * @return negative on error.
+ */
+int swtiChunkBuilderInit(SwtiChunkBuilder* self, size_t rootCount, size_t shardCount, ImprintAllocator* allocator)
+{
+    size_t requestedShardCount = shardCount == 0 ? SWTI_CHUNK_BUILDER_DEFAULT_SHARD_COUNT : shardCount;
+    size_t powerOfTwoShardCount = 1;
+    while (powerOfTwoShardCount < requestedShardCount) {
+        powerOfTwoShardCount *= 2;
+    }
+
+    self->shardCount = powerOfTwoShardCount;
+    self->rootCount = rootCount;
+    self->allocator = allocator;
+    self->shards = IMPRINT_ALLOC_TYPE_COUNT(allocator, SwtiChunkBuilderShard, self->shardCount);
+    self->roots = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiType*, rootCount + 1);
+    self->rootWorkers = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiChunkBuilderWorker*, rootCount + 1);
+    if (self->shards == 0 || self->roots == 0 || self->rootWorkers == 0) {
+        CLOG_SOFT_ERROR("swtiChunkBuilderInit: out of memory")
+        self->shards = 0;
+        self->roots = 0;
+        self->rootWorkers = 0;
+        self->shardCount = 0;
+        self->rootCount = 0;
+        return -1;
+    }
+
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        shardInit(&self->shards[i]);
+    }
+
+    return 0;
+}
+
+/***
+ * Releases the locks of the deduplication table. The memory stays in the allocators until they are freed.
+ * The types that have been added to the target chunk are not affected.
+ * @param self
+ */
+void swtiChunkBuilderDestroy(SwtiChunkBuilder* self)
+{
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        shardDestroy(&self->shards[i]);
+    }
+    self->allocator = 0;
+    self->shards = 0;
+    self->roots = 0;
+    self->rootWorkers = 0;
+    self->shardCount = 0;
+    self->rootCount = 0;
+}
+
+/***
+ * Prepares a worker. Each thread that adds types needs its own worker, and the workers must be kept until
+ * swtiChunkBuilderFinish() has returned.
+ * @param self
+ * @param builder the builder to add types to.
+ * @param allocator the allocator for the visited map of the worker and for the shards that it grows. It is only used
+ * from the thread of the worker, so it does not have to be thread safe. The allocations are never freed.
+ */
+void swtiChunkBuilderWorkerInit(SwtiChunkBuilderWorker* self, SwtiChunkBuilder* builder, ImprintAllocator* allocator)
+{
+    self->builder = builder;
+    self->allocator = allocator;
+    swtiTypeVisitedInit(&self->visited, allocator);
+    swtiTypeVisitedHashMemo(&self->visited, &self->hashMemo);
+    swtiTypeEqualCacheInit(&self->equalCache, self->equalCacheEntries, SWTI_CHUNK_BUILDER_EQUAL_CACHE_CAPACITY);
+}
+
+static int workerAddType(SwtiChunkBuilderWorker* self, const SwtiType* type);
+
+static int workerAddTypes(SwtiChunkBuilderWorker* self, const SwtiType* const* types, size_t count)
+{
+    int error;
+    for (size_t i = 0; i < count; ++i) {
+        if ((error = workerAddType(self, types[i])) < 0) {
+            return error;
+        }
+    }
+
+    return 0;
+}
+
+/// Walks the same sub types as addType() in add.c
+static int workerAddSubTypes(SwtiChunkBuilderWorker* self, const SwtiType* type)
+{
+    int error;
+
+    switch (type->type) {
+        case SwtiTypeCustom: {
+            const SwtiCustomType* custom = (const SwtiCustomType*) type;
+            for (size_t i = 0; i < custom->variantCount; ++i) {
+                const SwtiCustomTypeVariant* variant = custom->variantTypes[i];
+                for (size_t j = 0; j < variant->paramCount; ++j) {
+                    if ((error = workerAddType(self, variant->fields[j].fieldType)) < 0) {
+                        return error;
+                    }
+                }
+            }
+        } break;
+        case SwtiTypeFunction: {
+            const SwtiFunctionType* fn = (const SwtiFunctionType*) type;
+            return workerAddTypes(self, fn->parameterTypes, fn->parameterCount);
+        }
+        case SwtiTypeTuple: {
+            const SwtiTupleType* tuple = (const SwtiTupleType*) type;
+            for (size_t i = 0; i < tuple->fieldCount; ++i) {
+                if ((error = workerAddType(self, tuple->fields[i].fieldType)) < 0) {
+                    return error;
+                }
+            }
+        } break;
+        case SwtiTypeAlias:
+            return workerAddType(self, ((const SwtiAliasType*) type)->targetType);
+        case SwtiTypeRecord: {
+            const SwtiRecordType* record = (const SwtiRecordType*) type;
+            for (size_t i = 0; i < record->fieldCount; ++i) {
+                if ((error = workerAddType(self, record->fields[i].fieldType)) < 0) {
+                    return error;
+                }
+            }
+        } break;
+        case SwtiTypeArray:
+            return workerAddType(self, ((const SwtiArrayType*) type)->itemType);
+        case SwtiTypeList:
+            return workerAddType(self, ((const SwtiListType*) type)->itemType);
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+static int workerAddType(SwtiChunkBuilderWorker* self, const SwtiType* type)
+{
+    if (swtiTypeVisitedFind(&self->visited, type) >= 0) {
+        return 0;
+    }
+
+    // The sub types are hashed (and remembered) as part of the first type that refers to them
+    SwtiChunkBuilder* builder = self->builder;
+    uint32_t hash = swtiChunkTypeHashWithMemo(0, type, &self->hashMemo);
+    size_t shardIndex = hash & (builder->shardCount - 1);
+    SwtiChunkBuilderShard* shard = &builder->shards[shardIndex];
+
+    int indexInShard = shardFindOrInsert(shard, type, hash, &self->equalCache, self->allocator);
+    if (indexInShard < 0 || (size_t) indexInShard >= (INT_MAX - shardIndex) / builder->shardCount) {
+        CLOG_SOFT_ERROR("swtiChunkBuilderAdd: out of memory")
+        return -1;
+    }
+
+    int key = (int) ((size_t) indexInShard * builder->shardCount + shardIndex);
+    if (swtiTypeVisitedInsert(&self->visited, type, key) < 0) {
+        CLOG_SOFT_ERROR("swtiChunkBuilderAdd: out of memory")
+        return -1;
+    }
+
+    // All the sub types must be visited, even if an equal type was already in the table, since
+    // swtiChunkBuilderFinish() looks up each sub type of the root in this worker
+    return workerAddSubTypes(self, type);
+}
+
+/***
+ * Hashes and deduplicates a root type and all the types it refers to. Can be called from several threads at the
+ * same time, as long as each thread uses its own worker and each root index is only added once.
+ * @param self the worker for the calling thread.
+ * @param rootIndex the position of the root, the roots are added to the chunk in root index order.
+ * @param root the type to add.
+ * @return negative on error.
+ */
+int swtiChunkBuilderAdd(SwtiChunkBuilderWorker* self, size_t rootIndex, const SwtiType* root)
+{
+    SwtiChunkBuilder* builder = self->builder;
+    if (rootIndex >= builder->rootCount) {
+        CLOG_SOFT_ERROR("swtiChunkBuilderAdd: illegal root index %zu", rootIndex)
+        return -2;
+    }
+
+    int error = workerAddType(self, root);
+    if (error < 0) {
+        return error;
+    }
+
+    builder->roots[rootIndex] = root;
+    builder->rootWorkers[rootIndex] = self;
+
+    return 0;
+}
+
+static int resolveKey(void* userData, const SwtiType* type, uint32_t* hash)
+{
+    const SwtiChunkBuilderResolve* self = (const SwtiChunkBuilderResolve*) userData;
+    int key = swtiTypeVisitedFind(&self->worker->visited, type);
+    if (key < 0) {
+        return -1;
+    }
+
+    size_t shardCount = self->builder->shardCount;
+    size_t shardIndex = (size_t) key & (shardCount - 1);
+    size_t indexInShard = (size_t) key / shardCount;
+    *hash = self->builder->shards[shardIndex].storage.hashes[indexInShard];
+
+    // The keys are renumbered so they are dense, in shard order
+    return (int) (self->shardBases[shardIndex] + indexInShard);
+}
+
+/***
+ * Adds all the roots to the chunk, in root index order. The chunk gets the same types, in the same order, as if
+ * the roots had been added with swtiChunkAddTypes(), but the source types are not hashed or compared again.
+ * Must be called from one thread, after all the calls to swtiChunkBuilderAdd() have returned.
+ * @param self
+ * @param target the chunk to add to.
+ * @param indices receives the chunk index for each root, must have room for rootCount indices.
+ * @param allocator the allocator for the copied types.
+ * @return negative on error.
+ */
+int swtiChunkBuilderFinish(SwtiChunkBuilder* self, SwtiChunk* target, int* indices, ImprintAllocator* allocator)
+{
+    for (size_t i = 0; i < self->rootCount; ++i) {
+        if (self->rootWorkers[i] == 0) {
+            CLOG_SOFT_ERROR("swtiChunkBuilderFinish: root %zu was never added", i)
+            return -2;
+        }
+    }
+
+    size_t* shardBases = IMPRINT_ALLOC_TYPE_COUNT(self->allocator, size_t, self->shardCount);
+    if (shardBases == 0) {
+        CLOG_SOFT_ERROR("swtiChunkBuilderFinish: out of memory")
+        return -1;
+    }
+    size_t keyCount = 0;
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        shardBases[i] = keyCount;
+        keyCount += self->shards[i].count;
+    }
+
+    int* keyIndices = IMPRINT_ALLOC_TYPE_COUNT(self->allocator, int, keyCount + 1);
+    if (keyIndices == 0) {
+        CLOG_SOFT_ERROR("swtiChunkBuilderFinish: out of memory")
+        return -1;
+    }
+    for (size_t i = 0; i < keyCount; ++i) {
+        keyIndices[i] = -1;
+    }
+
+    SwtiChunkBuilderResolve resolve;
+    resolve.builder = self;
+    resolve.shardBases = shardBases;
+
+    int result = 0;
+    for (size_t i = 0; i < self->rootCount; ++i) {
+        resolve.worker = self->rootWorkers[i];
+        result = swtiChunkAddTypesResolved(target, &self->roots[i], 1, &indices[i], resolveKey, &resolve,
+                                           keyIndices, allocator);
+        if (result < 0) {
+            break;
+        }
+    }
+
+    return result;
+}
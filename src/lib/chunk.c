@@ -3,25 +3,343 @@
  *  Licensed under the MIT License. See LICENSE in the project root for license information.
  *--------------------------------------------------------------------------------------------*/
 #include <clog/clog.h>
-#include <flood/out_stream.h>
 #include <imprint/allocator.h>
 #include <swamp-typeinfo/add.h>
 #include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/custom.h>
 #include <swamp-typeinfo/equal.h>
+#include <swamp-typeinfo/hash.h>
+#include <swamp-typeinfo/image.h>
+#include <swamp-typeinfo/pointer_map.h>
+#include <swamp-typeinfo/record.h>
 #include <swamp-typeinfo/typeinfo.h>
+#include <swamp-typeinfo/value.h>
+
+#define SWTI_CHUNK_MIN_CAPACITY (16)
+
+/***
+ * The per-index arrays of a chunk. They are allocated together, so a failed allocation never leaves the chunk
+ * with a mix of old and new arrays.
+ */
+typedef struct SwtiChunkStorage {
+    const SwtiType** types;
+    uint8_t* kinds;
+    SwtiMemoryInfo* layouts;
+    uint32_t* unaliased;
+    const SwtiRecordFieldIndex** fieldIndices;
+    const SwtiCustomVariantTable** variantTables;
+    const SwtiValuePlan** valuePlans;
+    const SwtiValuePlan** copyPlans;
+    const SwtiPointerMap** pointerMaps;
+    const char** debugStrings;
+    uint32_t* hashes;
+    uint32_t* nameHashes;
+} SwtiChunkStorage;
+
+static int allocateStorage(ImprintAllocator* allocator, size_t maxCount, SwtiChunkStorage* out)
+{
+    out->types = IMPRINT_ALLOC_TYPE_COUNT(allocator, const SwtiType*, maxCount);
+    out->kinds = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint8_t, maxCount);
+    out->layouts = IMPRINT_ALLOC_TYPE_COUNT(allocator, SwtiMemoryInfo, maxCount);
+    out->unaliased = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint32_t, maxCount);
+    out->fieldIndices = IMPRINT_ALLOC_TYPE_COUNT(allocator, const SwtiRecordFieldIndex*, maxCount);
+    out->variantTables = IMPRINT_ALLOC_TYPE_COUNT(allocator, const SwtiCustomVariantTable*, maxCount);
+    out->valuePlans = IMPRINT_ALLOC_TYPE_COUNT(allocator, const SwtiValuePlan*, maxCount);
+    out->copyPlans = IMPRINT_ALLOC_TYPE_COUNT(allocator, const SwtiValuePlan*, maxCount);
+    out->pointerMaps = IMPRINT_ALLOC_TYPE_COUNT(allocator, const SwtiPointerMap*, maxCount);
+    out->debugStrings = IMPRINT_ALLOC_TYPE_COUNT(allocator, const char*, maxCount);
+    out->hashes = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint32_t, maxCount);
+    out->nameHashes = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint32_t, maxCount);
+
+    if (out->types == 0 || out->kinds == 0 || out->layouts == 0 || out->unaliased == 0 || out->fieldIndices == 0 ||
+        out->variantTables == 0 || out->valuePlans == 0 || out->copyPlans == 0 || out->pointerMaps == 0 ||
+        out->debugStrings == 0 || out->hashes == 0 || out->nameHashes == 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void setStorage(SwtiChunk* self, const SwtiChunkStorage* storage, size_t maxCount)
+{
+    self->maxCount = maxCount;
+    self->types = storage->types;
+    self->kinds = storage->kinds;
+    self->layouts = storage->layouts;
+    self->unaliased = storage->unaliased;
+    self->fieldIndices = storage->fieldIndices;
+    self->variantTables = storage->variantTables;
+    self->valuePlans = storage->valuePlans;
+    self->copyPlans = storage->copyPlans;
+    self->pointerMaps = storage->pointerMaps;
+    self->debugStrings = storage->debugStrings;
+    self->hashes = storage->hashes;
+    self->nameHashes = storage->nameHashes;
+}
+
+static void copyStorage(SwtiChunkStorage* target, const SwtiChunk* self)
+{
+    tc_memcpy_type(const SwtiType*, target->types, self->types, self->typeCount);
+    tc_memcpy_type(uint8_t, target->kinds, self->kinds, self->typeCount);
+    tc_memcpy_type(SwtiMemoryInfo, target->layouts, self->layouts, self->typeCount);
+    tc_memcpy_type(uint32_t, target->unaliased, self->unaliased, self->typeCount);
+    tc_memcpy_type(const SwtiRecordFieldIndex*, target->fieldIndices, self->fieldIndices, self->typeCount);
+    tc_memcpy_type(const SwtiCustomVariantTable*, target->variantTables, self->variantTables, self->typeCount);
+    tc_memcpy_type(const SwtiValuePlan*, target->valuePlans, self->valuePlans, self->typeCount);
+    tc_memcpy_type(const SwtiValuePlan*, target->copyPlans, self->copyPlans, self->typeCount);
+    tc_memcpy_type(const SwtiPointerMap*, target->pointerMaps, self->pointerMaps, self->typeCount);
+    tc_memcpy_type(const char*, target->debugStrings, self->debugStrings, self->typeCount);
+    tc_memcpy_type(uint32_t, target->hashes, self->hashes, self->typeCount);
+    tc_memcpy_type(uint32_t, target->nameHashes, self->nameHashes, self->typeCount);
+}
+
+static void clearStorage(SwtiChunk* self)
+{
+    SwtiChunkStorage empty;
+    tc_mem_clear_type(&empty);
+    setStorage(self, &empty, 0);
+    self->typeCount = 0;
+}
+
+static uint32_t* copySlots(SwtiChunk* self, const SwtiHashIndex* index)
+{
+    uint32_t* slots = IMPRINT_ALLOC_TYPE_COUNT(self->allocator, uint32_t, index->capacity);
+    if (slots != 0) {
+        tc_memcpy_type_n(slots, index->slots, index->capacity);
+    }
+
+    return slots;
+}
+
+/// The arrays are used in place from the image until the chunk needs to modify them.
+static int detachFromImage(SwtiChunk* self)
+{
+    if (self->image == 0 || self->hashIndex.slots != self->image->hashIndex.slots) {
+        return 0;
+    }
+
+    uint32_t* hashSlots = copySlots(self, &self->hashIndex);
+    uint32_t* nameSlots = copySlots(self, &self->nameIndex);
+    if (hashSlots == 0 || nameSlots == 0) {
+        return -1;
+    }
+    self->hashIndex.slots = hashSlots;
+    self->nameIndex.slots = nameSlots;
+
+    return 0;
+}
+
+/***
+ * Makes sure that the chunk can hold at least @p capacity types. The storage is reallocated from the chunk allocator
+ * and the previous storage is abandoned (the allocator is expected to be a linear/arena allocator).
+ * @param self
+ * @param capacity the minimum number of types.
+ * @return negative on error.
+ */
+int swtiChunkReserve(SwtiChunk* self, size_t capacity)
+{
+    if (capacity <= self->maxCount) {
+        return 0;
+    }
+    if (self->frozen) {
+        CLOG_SOFT_ERROR("swtiChunkReserve: chunk is frozen")
+        return -2;
+    }
+
+    if (detachFromImage(self) < 0) {
+        CLOG_SOFT_ERROR("swtiChunkReserve: out of memory")
+        return -1;
+    }
+
+    // The chunk is left untouched until all the allocations have succeeded
+    SwtiChunkStorage grown;
+    if (allocateStorage(self->allocator, capacity, &grown) < 0) {
+        CLOG_SOFT_ERROR("swtiChunkReserve: out of memory")
+        return -1;
+    }
+
+    if (self->typeCount > 0) {
+        copyStorage(&grown, self);
+    }
+    setStorage(self, &grown, capacity);
+
+    return 0;
+}
+
+static int growStorage(SwtiChunk* self)
+{
+    size_t capacity = self->maxCount < SWTI_CHUNK_MIN_CAPACITY ? SWTI_CHUNK_MIN_CAPACITY : self->maxCount * 2;
+
+    return swtiChunkReserve(self, capacity);
+}
+
+static int isInChunk(const SwtiChunk* self, const SwtiType* type)
+{
+    return (uintptr_t) (const void*) type >= 256 && type->index < self->typeCount && self->types[type->index] == type;
+}
+
+/// All types before @p index must already be resolved. If the alias chain leaves the chunk, the alias itself is used.
+static uint32_t resolveUnaliased(const SwtiChunk* self, size_t index)
+{
+    const SwtiType* type = self->types[index];
+    while (type->type == SwtiTypeAlias) {
+        const SwtiType* target = ((const SwtiAliasType*) type)->targetType;
+        if ((uintptr_t) (const void*) target < 256) {
+            return (uint32_t) index;
+        }
+        if (isInChunk(self, target) && target->index < index) {
+            return self->unaliased[target->index];
+        }
+        type = target;
+    }
+
+    return isInChunk(self, type) ? type->index : (uint32_t) index;
+}
+
+/// Gets the name without materializing the type, if the chunk is backed by an image.
+static const char* typeName(const SwtiChunk* self, size_t index)
+{
+    const SwtiType* type = self->types[index];
+    if (type == 0 && self->image != 0) {
+        return swtiChunkImageString(self->image, swtiChunkImageEntry(self->image, index)->name);
+    }
+
+    return type->name;
+}
+
+static int findName(const SwtiChunk* self, const char* name, uint32_t nameHash)
+{
+    SwtiHashIndexProbe probe;
+    swtiHashIndexProbeInit(&probe, &self->nameIndex, nameHash);
+    SWTI_CHUNK_STATS_ADD(self, findNameCount, 1);
+    int i;
+    while ((i = swtiHashIndexProbeNext(&probe, &self->nameIndex, self->nameHashes)) >= 0) {
+        SWTI_CHUNK_STATS_ADD(self, probeCount, 1);
+        const char* foundName = typeName(self, i);
+        if (foundName != 0 && tc_str_equal(foundName, name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/// Only the first type with a specific name is added to the name index. Unnamed types are never added.
+static int insertName(SwtiChunk* self, size_t index)
+{
+    const char* name = self->types[index]->name;
+    uint32_t nameHash = swtiStringHash(name);
+    self->nameHashes[index] = nameHash;
+    if (name == 0 || findName(self, name, nameHash) >= 0) {
+        return 0;
+    }
+
+    return swtiHashIndexInsert(&self->nameIndex, self->nameHashes, index, self->allocator);
+}
 
 /**
- * Initializes the type information for a package. The @p types are copied.
+ * Initializes the type information for a package. The array of @p types is copied, but the types themselves are
+ * taken over by the chunk: their index is set to their position in the chunk and their hash is calculated, so they
+ * must not be part of another chunk.
+ * If the storage can not be allocated, the chunk is left empty (but valid) and an error is returned.
  * @param types An array of pointers to the types to be stored.
  * @param typeCount The number of items in the \p types array.
+ * @return negative on error.
  */
-void swtiChunkInit(SwtiChunk* self, const SwtiType** types, size_t typeCount, struct ImprintAllocator* allocator)
+int swtiChunkInit(SwtiChunk* self, SwtiType** types, size_t typeCount, struct ImprintAllocator* allocator)
 {
-    self->types = IMPRINT_ALLOC_TYPE_COUNT(allocator, const SwtiType*, typeCount);
+    // Without the counters the chunk is still usable, it just does not count anything
+    SwtiChunkDiagnostics* diagnostics = IMPRINT_ALLOC_TYPE(allocator, SwtiChunkDiagnostics);
+#if SWTI_CHUNK_STATS
+    self->stats = diagnostics != 0 ? IMPRINT_CALLOC_TYPE(allocator, SwtiChunkStats) : 0;
+    if (self->stats != 0) {
+        swtiCountingAllocatorInit(&self->countingAllocator, allocator, self->stats);
+        allocator = &self->countingAllocator.info;
+    } else {
+        diagnostics = 0;
+    }
+#endif
+    if (diagnostics != 0) {
+        swtiChunkDiagnosticsInit(diagnostics);
+    }
+    self->diagnostics = diagnostics;
+    self->allocator = allocator;
+    self->image = 0;
+    self->frozen = 0;
+    swtiTypeVisitedInit(&self->addVisited, allocator);
+    swtiHashIndexInit(&self->hashIndex);
+    swtiHashIndexInit(&self->nameIndex);
+    swtiStringTableInit(&self->strings, allocator);
+    clearStorage(self);
+    if (diagnostics == 0) {
+        CLOG_SOFT_ERROR("swtiChunkInit: out of memory")
+        return -1;
+    }
+    if (typeCount == 0) {
+        return 0;
+    }
+
+    SwtiChunkStorage storage;
+    if (allocateStorage(allocator, typeCount, &storage) < 0) {
+        CLOG_SOFT_ERROR("swtiChunkInit: out of memory")
+        return -1;
+    }
+    setStorage(self, &storage, typeCount);
     self->typeCount = typeCount;
-    tc_memcpy_type(const SwtiType*, self->types, types, typeCount);
+
+    for (size_t i = 0; i < typeCount; ++i) {
+        types[i]->index = i;
+        self->types[i] = types[i];
+        self->kinds[i] = (uint8_t) types[i]->type;
+        swtiGetMemoryInfo(types[i], &self->layouts[i]);
+        self->hashes[i] = 0;
+    }
+
+    for (size_t i = 0; i < typeCount; ++i) {
+        self->unaliased[i] = resolveUnaliased(self, i);
+        if (swtiChunkBuildTypeTables(self, i) < 0) {
+            CLOG_SOFT_ERROR("swtiChunkInit: couldn't build the type tables")
+            clearStorage(self);
+            return -1;
+        }
+    }
+
+    if (swtiHashIndexReserve(&self->hashIndex, self->hashes, typeCount, allocator) < 0 ||
+        swtiHashIndexReserve(&self->nameIndex, self->nameHashes, typeCount, allocator) < 0) {
+        CLOG_SOFT_ERROR("swtiChunkInit: out of memory")
+        clearStorage(self);
+        swtiHashIndexInit(&self->hashIndex);
+        swtiHashIndexInit(&self->nameIndex);
+        return -1;
+    }
+
+    // Can not fail, the room in the indices was reserved above
+    for (size_t i = 0; i < typeCount; ++i) {
+        swtiChunkTypeHash(self, self->types[i]);
+        swtiHashIndexInsert(&self->hashIndex, self->hashes, i, allocator);
+        insertName(self, i);
+    }
+
+    return 0;
 }
 
+/***
+ * Initializes an empty chunk. The storage grows as types are added, @p capacityHint avoids the reallocations
+ * if the number of types is known in advance.
+ * @param self
+ * @param capacityHint the number of types to reserve space for, can be zero.
+ * @param allocator the allocator for the chunk storage.
+ * @return negative on error, the chunk is then empty.
+ */
+int swtiChunkInitWithCapacity(SwtiChunk* self, size_t capacityHint, struct ImprintAllocator* allocator)
+{
+    int error = swtiChunkInit(self, 0, 0, allocator);
+    if (error < 0) {
+        return error;
+    }
+
+    return swtiChunkReserve(self, capacityHint);
+}
 
 /***
  * Destroys the chunk.
@@ -32,82 +350,352 @@ void swtiChunkDestroy(SwtiChunk* self)
     self->types = 0;
     self->typeCount = 0;
     self->maxCount = 0;
+    self->kinds = 0;
+    self->layouts = 0;
+    self->unaliased = 0;
+    self->fieldIndices = 0;
+    self->variantTables = 0;
+    self->valuePlans = 0;
+    self->copyPlans = 0;
+    self->pointerMaps = 0;
+    self->debugStrings = 0;
+    self->hashes = 0;
+    self->nameHashes = 0;
+    self->allocator = 0;
+    self->image = 0;
+    self->frozen = 0;
+    swtiTypeVisitedInit(&self->addVisited, 0);
+    swtiHashIndexInit(&self->hashIndex);
+    swtiHashIndexInit(&self->nameIndex);
+    swtiStringTableInit(&self->strings, 0);
 }
 
-int swtiChunkFind(const SwtiChunk* self, const SwtiType* typeToSearchFor)
+/***
+ * Builds everything that is otherwise built lazily and makes the chunk immutable. All types are materialized
+ * and the hashes, value and copy plans, pointer maps and debug strings are built for every index.
+ * After this, all lookups on the chunk are read only: they never allocate or write to the chunk, so any number of
+ * threads can use it at the same time without locks. The lookup counters are not updated for a frozen chunk.
+ * Adding types to a frozen chunk fails.
+ * Hand the chunk over to the other threads after this returns, e.g. before they are started.
+ * @param self
+ * @return negative on error.
+ */
+int swtiChunkFreeze(SwtiChunk* self)
 {
+    if (self->frozen) {
+        return 0;
+    }
+
     for (size_t i = 0; i < self->typeCount; ++i) {
-        const struct SwtiType* type = self->types[i];
-        if (typeToSearchFor->hash == type->hash) {
-            if (typeToSearchFor->type != type->type) {
-                CLOG_SOFT_ERROR("something is wrong here. Hash collide %zu %s vs %s", i, typeToSearchFor->name,
-                                type->name);
-            }
+        const SwtiType* type = swtiChunkTypeFromIndex(self, i);
+        if (type == 0) {
+            CLOG_SOFT_ERROR("swtiChunkFreeze: could not materialize type %zu", i)
+            return -1;
+        }
+        if (self->hashes[i] == 0) {
+            swtiChunkTypeHash(self, type);
+        }
+    }
 
-            return i;
+    for (size_t i = 0; i < self->typeCount; ++i) {
+        // Types without a value layout (e.g. functions) have no plans, that is not an error
+        swtiChunkValuePlan(self, i);
+        swtiChunkCopyPlan(self, i);
+        swtiChunkPointerMap(self, i);
+        if (swtiChunkDebugTypeString(self, i) == 0) {
+            return -2;
         }
     }
 
-    return -1;
+    self->frozen = 1;
+
+    return 0;
+}
+
+/***
+ * Adds the type to the chunk and calculates its structural hash. The type is not checked for duplicates.
+ * @param self
+ * @param type the type to add. All types it references must already be added.
+ * @return the index of the type, or negative on error. On error the chunk and the type are left unchanged.
+ */
+int swtiChunkInsert(SwtiChunk* self, const SwtiType* type)
+{
+    int error;
+
+    if (self->frozen) {
+        CLOG_SOFT_ERROR("swtiChunkInsert: chunk is frozen")
+        return -2;
+    }
+
+    if (self->typeCount == self->maxCount) {
+        if ((error = growStorage(self)) < 0) {
+            return error;
+        }
+    }
+
+    // Everything that can fail is done before the type is visible in the chunk, so an error leaves the chunk as it was
+    size_t newIndex = self->typeCount;
+    self->types[newIndex] = type;
+    self->kinds[newIndex] = (uint8_t) type->type;
+    self->hashes[newIndex] = 0;
+    // Types without a memory layout (e.g. functions) get zero size and alignment
+    swtiGetMemoryInfo(type, &self->layouts[newIndex]);
+    self->unaliased[newIndex] = resolveUnaliased(self, newIndex);
+    if ((error = swtiChunkBuildTypeTables(self, newIndex)) < 0) {
+        return error;
+    }
+    if ((error = swtiHashIndexReserve(&self->hashIndex, self->hashes, newIndex + 1, self->allocator)) < 0) {
+        return error;
+    }
+    if ((error = swtiHashIndexReserve(&self->nameIndex, self->nameHashes, newIndex + 1, self->allocator)) < 0) {
+        return error;
+    }
+
+    self->typeCount++;
+    ((SwtiType*) type)->index = newIndex;
+    swtiChunkTypeHash(self, type);
+
+    // Can not fail, the room was reserved above
+    swtiHashIndexInsert(&self->hashIndex, self->hashes, newIndex, self->allocator);
+    insertName(self, newIndex);
+
+    return newIndex;
+}
+
+/***
+ * Builds the lookup tables that belong to a single type, the field name index for records and the variant tables
+ * for custom types.
+ * Called when the type is added or materialized.
+ * @param self
+ * @param index the type index, the type must be complete.
+ * @return negative on error.
+ */
+int swtiChunkBuildTypeTables(const SwtiChunk* self, size_t index)
+{
+    const SwtiType* type = self->types[index];
+    self->fieldIndices[index] = 0;
+    self->variantTables[index] = 0;
+    self->valuePlans[index] = 0;
+    self->copyPlans[index] = 0;
+    self->pointerMaps[index] = 0;
+    self->debugStrings[index] = 0;
+
+    int error;
+    if (type->type == SwtiTypeRecord) {
+        SwtiRecordFieldIndex* fieldIndex = IMPRINT_ALLOC_TYPE(self->allocator, SwtiRecordFieldIndex);
+        if (fieldIndex == 0) {
+            return -1;
+        }
+        if ((error = swtiRecordFieldIndexInit(fieldIndex, (const SwtiRecordType*) type, self->allocator)) < 0) {
+            return error;
+        }
+        self->fieldIndices[index] = fieldIndex;
+    } else if (type->type == SwtiTypeCustom) {
+        SwtiCustomVariantTable* variantTable = IMPRINT_ALLOC_TYPE(self->allocator, SwtiCustomVariantTable);
+        if (variantTable == 0) {
+            return -1;
+        }
+        if ((error = swtiCustomVariantTableInit(variantTable, (const SwtiCustomType*) type, self->allocator)) < 0) {
+            return error;
+        }
+        self->variantTables[index] = variantTable;
+    }
+
+    return 0;
+}
+
+static uint32_t typeHashForLookup(const SwtiChunk* self, const SwtiType* type)
+{
+    if (type->index < self->typeCount && self->types[type->index] == type) {
+        return self->hashes[type->index];
+    }
+
+    return swtiTypeHash(type);
+}
+
+/***
+ * Finds a type with the same structural hash and type kind.
+ * @param self
+ * @param typeToSearchFor the type to search for.
+ * @return the lowest index with a matching hash, or -1 if not found.
+ */
+int swtiChunkFind(const SwtiChunk* self, const SwtiType* typeToSearchFor)
+{
+    int foundIndex = -1;
+    SwtiHashIndexProbe probe;
+    swtiHashIndexProbeInit(&probe, &self->hashIndex, typeHashForLookup(self, typeToSearchFor));
+    SWTI_CHUNK_STATS_KIND(self, findCount, typeToSearchFor->type);
+    size_t probeLength = 0;
+    int i;
+    while ((i = swtiHashIndexProbeNext(&probe, &self->hashIndex, self->hashes)) >= 0) {
+        probeLength++;
+        if (self->kinds[i] != typeToSearchFor->type) {
+            swtiChunkDiagnosticsReport(self, SwtiChunkDiagnosticKindCollision, i, typeToSearchFor->name);
+            continue;
+        }
+        if (foundIndex < 0 || i < foundIndex) {
+            foundIndex = i;
+        }
+    }
+    SWTI_CHUNK_STATS_ADD(self, probeCount, probeLength);
+    SWTI_CHUNK_STATS_MAX(self, maxProbeLength, probeLength);
+
+    return foundIndex;
 }
 
 
 /***
- * Finds a type given the name of the type.
+ * Finds a type given the name of the type. If several types have the same name, the first one added is returned.
  * @param self
  * @param typeToSearchFor the string to search for.
  * @return the index for the found type, or -1 if not found.
  */
 int swtiChunkFindFromName(const SwtiChunk* self, const char* typeToSearchFor)
 {
-    for (size_t i = 0; i < self->typeCount; ++i) {
-        const struct SwtiType* type = self->types[i];
-        if (tc_str_equal(type->name, typeToSearchFor)) {
-            return i;
-        }
+    if (typeToSearchFor == 0) {
+        return -1;
     }
 
-    return -1;
+    return findName(self, typeToSearchFor, swtiStringHash(typeToSearchFor));
 }
 
 /***
  * Gets a type given the name of the type.
  * @param self
  * @param typeToSearchFor the string to search for.
- * @return the found type or error if not found.
+ * @return the found type or null if not found. Misses are counted in the chunk diagnostics.
  */
 const SwtiType* swtiChunkGetFromName(const SwtiChunk* self, const char* typeToSearchFor)
 {
     int index = swtiChunkFindFromName(self, typeToSearchFor);
     if (index < 0) {
-        CLOG_ERROR("couldn't find type '%s'", typeToSearchFor)
+        swtiChunkDiagnosticsReport(self, SwtiChunkDiagnosticNameMiss, -1, typeToSearchFor);
         return 0;
     }
 
     return swtiChunkTypeFromIndex(self, index);
 }
 
+/***
+ * Finds a type that is structurally equal (see swtiTypeEqual()). Only the types with the same structural hash are
+ * compared, so it is normally one probe and one equality check.
+ * @param self
+ * @param typeToSearchFor the type to search for.
+ * @return the index of the equal type, or -1 if not found.
+ */
 int swtiChunkFindDeep(const SwtiChunk* self, const SwtiType* typeToSearchFor)
 {
-    for (size_t i = 0; i < self->typeCount; ++i) {
-        const struct SwtiType* type = self->types[i];
-        if (typeToSearchFor->type == type->type) {
-            if (swtiTypeEqual(typeToSearchFor, type) == 0) {
-                return i;
-            }
+    return swtiChunkFindDeepWithHash(self, typeToSearchFor, typeHashForLookup(self, typeToSearchFor), 0);
+}
+
+/***
+ * Same as swtiChunkFindDeep(), but uses an already known structural hash, e.g. from the chunk that owns the type.
+ * @param self
+ * @param typeToSearchFor the type to search for.
+ * @param hash the structural hash for @p typeToSearchFor (see swtiTypeHash()).
+ * @param cache the cache for the type comparisons, can be null.
+ * @return the index of the equal type, or -1 if not found.
+ */
+int swtiChunkFindDeepWithHash(const SwtiChunk* self, const SwtiType* typeToSearchFor, uint32_t hash,
+                              SwtiTypeEqualCache* cache)
+{
+#if SWTI_CHUNK_STATS
+    SwtiTypeEqualCache countingCache;
+    if (cache == 0) {
+        swtiTypeEqualCacheInit(&countingCache, 0, 0);
+        cache = &countingCache;
+    }
+    uint64_t equalCallCount = cache->callCount;
+#endif
+    SWTI_CHUNK_STATS_KIND(self, findDeepCount, typeToSearchFor->type);
+
+    SwtiHashIndexProbe probe;
+    swtiHashIndexProbeInit(&probe, &self->hashIndex, hash);
+    size_t probeLength = 0;
+    int foundIndex = -1;
+    int i;
+    while ((i = swtiHashIndexProbeNext(&probe, &self->hashIndex, self->hashes)) >= 0) {
+        probeLength++;
+        if (self->kinds[i] != typeToSearchFor->type) {
+            continue;
+        }
+        // Only the candidates with matching hash and kind are touched (and materialized)
+        const struct SwtiType* type = swtiChunkTypeFromIndex(self, i);
+        if (type != 0 && swtiTypeEqualCached(typeToSearchFor, type, cache) == 0) {
+            foundIndex = i;
+            break;
         }
     }
+    SWTI_CHUNK_STATS_ADD(self, probeCount, probeLength);
+    SWTI_CHUNK_STATS_MAX(self, maxProbeLength, probeLength);
+    SWTI_CHUNK_STATS_ADD(self, equalCallCount, cache->callCount - equalCallCount);
+    SWTI_CHUNK_STATS_MAX(self, equalMaxDepth, cache->maxDepth);
 
-    return -1;
+    return foundIndex;
+}
+
+/***
+ * Gets the index of the type that is left when all the aliases are resolved. Precalculated when the type is added.
+ * @param self
+ * @param index the type index, can be an alias.
+ * @return the unaliased type index, or @p index if it is not an alias or not in the chunk.
+ */
+size_t swtiChunkUnaliasIndex(const SwtiChunk* self, size_t index)
+{
+    if (index >= self->typeCount) {
+        return index;
+    }
+
+    size_t unaliased = self->unaliased[index];
+
+    // The table can come straight from an image, that is not validated entry by entry
+    return unaliased < self->typeCount ? unaliased : index;
+}
+
+/***
+ * Same as swtiUnalias(), but uses the precalculated table for types that are in the chunk.
+ * @param self
+ * @param maybeAlias the type to resolve.
+ * @return the unaliased type.
+ */
+const SwtiType* swtiChunkUnalias(const SwtiChunk* self, const SwtiType* maybeAlias)
+{
+    if (maybeAlias->type != SwtiTypeAlias) {
+        return maybeAlias;
+    }
+
+    if (isInChunk(self, maybeAlias)) {
+        return swtiChunkTypeFromIndex(self, self->unaliased[maybeAlias->index]);
+    }
+
+    return swtiUnalias(maybeAlias);
 }
 
+/***
+ * Initializes the chunk and adds the root type and all the types it references.
+ * @param targetChunk the chunk to initialize.
+ * @param rootType the type to add.
+ * @param index the index of the root type, or the negative error.
+ * @param allocator the allocator for the chunk storage and the copied types.
+ * @return negative on error.
+ */
 int swtiChunkInitOnlyOneType(SwtiChunk* targetChunk, const SwtiType *rootType, int* index, struct ImprintAllocator* allocator)
 {
-    swtiChunkInit(targetChunk, 0, 0, allocator);
-    targetChunk->maxCount = 8*1024;
-    targetChunk->types = IMPRINT_ALLOC_TYPE_COUNT(allocator, const SwtiType*, targetChunk->maxCount);
+    return swtiChunkInitOnlyOneTypeWithCapacity(targetChunk, rootType, index, 0, allocator);
+}
 
+/***
+ * Same as swtiChunkInitOnlyOneType(), but reserves room for @p capacityHint types up front.
+ */
+int swtiChunkInitOnlyOneTypeWithCapacity(SwtiChunk* targetChunk, const SwtiType* rootType, int* index, size_t capacityHint,
+                                         struct ImprintAllocator* allocator)
+{
     int rootTypeIndex;
+    if ((rootTypeIndex = swtiChunkInitWithCapacity(targetChunk, capacityHint, allocator)) < 0) {
+        *index = rootTypeIndex;
+        return rootTypeIndex;
+    }
+
     if ((rootTypeIndex = swtiChunkAddType(targetChunk, rootType, allocator)) < 0) {
         *index = rootTypeIndex;
         return rootTypeIndex;
@@ -120,6 +708,7 @@ int swtiChunkInitOnlyOneType(SwtiChunk* targetChunk, const SwtiType *rootType, i
 
 /***
  * Returns the type given the index into the internal types array.
+ * If the chunk is backed by an image, the type is materialized the first time it is requested.
  * @param self
  * @param index zero based index.
  * @return the found type, or 0 if not found.
@@ -129,34 +718,119 @@ const SwtiType* swtiChunkTypeFromIndex(const SwtiChunk* self, size_t index)
     if (index >= self->typeCount) {
         return 0;
     }
-    return self->types[index];
+
+    const SwtiType* type = self->types[index];
+    if (type == 0 && self->image != 0) {
+        type = swtiChunkMaterialize(self, index);
+    }
+
+    return type;
+}
+
+typedef struct SwtiDebugStringBuilder {
+    char* octets;
+    size_t count;
+} SwtiDebugStringBuilder;
+
+static int countSink(void* userData, const char* text, size_t length)
+{
+    ((SwtiDebugStringBuilder*) userData)->count += length;
+
+    return 0;
+}
+
+static int copySink(void* userData, const char* text, size_t length)
+{
+    SwtiDebugStringBuilder* builder = (SwtiDebugStringBuilder*) userData;
+    tc_memcpy_octets(builder->octets + builder->count, text, length);
+    builder->count += length;
+
+    return 0;
 }
 
 /***
- * Prints all the contained types to `stderr`. The formatting is subject to change, so only use it for debugging.
- * @param chunk
- * @param flags
- * @param debug
+ * Gets the debug string for a type, formatted without any flags. The string is built the first time it is
+ * requested and then cached in the chunk.
+ * @param self
+ * @param index the type index.
+ * @return the debug string, or null on error.
  */
-void swtiChunkDebugOutput(const SwtiChunk* chunk, int flags, const char* debug)
+const char* swtiChunkDebugTypeString(const SwtiChunk* self, size_t index)
 {
-#define TEMP_BUFFER_SIZE (64 * 1024)
-    uint8_t debugOut[TEMP_BUFFER_SIZE];
-    FldOutStream stream;
-    fldOutStreamInit(&stream, debugOut, TEMP_BUFFER_SIZE);
+    if (index >= self->typeCount) {
+        return 0;
+    }
+
+    const char* cached = self->debugStrings[index];
+    if (cached != 0 || self->frozen) {
+        return cached;
+    }
+
+    const SwtiType* type = swtiChunkTypeFromIndex(self, index);
+    if (type == 0) {
+        return 0;
+    }
+
+    // Measure first, so the string can be allocated once from the chunk allocator
+    SwtiDebugStringBuilder builder;
+    builder.octets = 0;
+    builder.count = 0;
+    if (swtiDebugWrite(countSink, &builder, 0, type) < 0) {
+        return 0;
+    }
+
+    char* octets = IMPRINT_ALLOC_TYPE_COUNT(self->allocator, char, builder.count + 1);
+    if (octets == 0) {
+        return 0;
+    }
+    builder.octets = octets;
+    builder.count = 0;
+    swtiDebugWrite(copySink, &builder, 0, type);
+    octets[builder.count] = 0;
+
+    self->debugStrings[index] = octets;
 
-    fldOutStreamRewind(&stream);
+    return octets;
+}
 
-    fldOutStreamWritef(&stream,"typeInformation: typeCount: %d\n", chunk->typeCount);
-    for (size_t i = 0; i < chunk->typeCount; i++) {
-        fldOutStreamWritef(&stream,"%d: ", i);
-        swtiDebugOutput(&stream, flags, chunk->types[i]);
-        fldOutStreamWriteUInt8(&stream, '\n');
+/***
+ * Writes all the contained types to the sink, through a small buffer on the stack. The formatting is subject to
+ * change, so only use it for debugging.
+ * @param self
+ * @param flags
+ * @param sink receives the output.
+ * @param userData passed on to the sink.
+ * @return negative on error.
+ */
+int swtiChunkDebugWrite(const SwtiChunk* self, int flags, SwtiDebugSink sink, void* userData)
+{
+    char buffer[SWTI_DEBUG_WRITER_BUFFER_SIZE];
+    SwtiDebugWriter writer;
+    swtiDebugWriterInit(&writer, buffer, sizeof(buffer), sink, userData);
+
+    swtiDebugWriterWritef(&writer, "typeInformation: typeCount: %zu\n", self->typeCount);
+    for (size_t i = 0; i < self->typeCount && writer.error >= 0; i++) {
+        swtiDebugWriterWritef(&writer, "%zu: ", i);
+        const char* cached = flags == 0 ? swtiChunkDebugTypeString(self, i) : 0;
+        if (cached != 0) {
+            swtiDebugWriterWrites(&writer, cached);
+        } else {
+            swtiDebugWriterWriteType(&writer, (SwtiDebugOutputFlags) flags, swtiChunkTypeFromIndex(self, i));
+        }
+        swtiDebugWriterWrite(&writer, "\n", 1);
     }
-    fldOutStreamWriteUInt8(&stream, 0);
 
-    const char* debugString = (const char*) debugOut;
+    return swtiDebugWriterFlush(&writer);
+}
 
+/***
+ * Prints all the contained types to `stderr`. The formatting is subject to change, so only use it for debugging.
+ * @param chunk
+ * @param flags
+ * @param debug
+ */
+void swtiChunkDebugOutput(const SwtiChunk* chunk, int flags, const char* debug)
+{
     fprintf(stderr, "\n-----%s:\n", debug);
-    fputs(debugString, stderr);
+    swtiChunkDebugWrite(chunk, flags, swtiDebugFileSink, stderr);
 }
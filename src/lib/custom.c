@@ -0,0 +1,145 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/custom.h>
+
+static int initLayout(SwtiVariantLayout* layout, const SwtiCustomTypeVariant* variant, struct ImprintAllocator* allocator)
+{
+    layout->variant = variant;
+    layout->memoryInfo = variant->memoryInfo;
+    layout->fieldCount = variant->paramCount;
+    layout->fieldOffsets = 0;
+    if (variant->paramCount == 0) {
+        return 0;
+    }
+
+    SwtiMemoryOffsetInfo* fieldOffsets = IMPRINT_ALLOC_TYPE_COUNT(allocator, SwtiMemoryOffsetInfo, variant->paramCount);
+    if (fieldOffsets == 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < variant->paramCount; ++i) {
+        fieldOffsets[i] = variant->fields[i].memoryOffsetInfo;
+    }
+    layout->fieldOffsets = fieldOffsets;
+
+    return 0;
+}
+
+/***
+ * Builds the variant name index and the tag to layout table for a custom type.
+ * The custom type must not change after this.
+ * @param self
+ * @param custom the custom type.
+ * @param allocator the allocator for the tables.
+ * @return negative on error.
+ */
+int swtiCustomVariantTableInit(SwtiCustomVariantTable* self, const SwtiCustomType* custom,
+                               struct ImprintAllocator* allocator)
+{
+    swtiHashIndexInit(&self->nameIndex);
+    self->variantCount = custom->variantCount;
+    self->nameHashes = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint32_t, custom->variantCount);
+    self->layouts = IMPRINT_ALLOC_TYPE_COUNT(allocator, SwtiVariantLayout, custom->variantCount);
+    if ((self->nameHashes == 0 || self->layouts == 0) && custom->variantCount > 0) {
+        CLOG_SOFT_ERROR("swtiCustomVariantTableInit: out of memory")
+        return -1;
+    }
+
+    int error;
+    for (size_t i = 0; i < custom->variantCount; ++i) {
+        const SwtiCustomTypeVariant* variant = custom->variantTypes[i];
+        if ((error = initLayout(&self->layouts[i], variant, allocator)) < 0) {
+            return error;
+        }
+        self->nameHashes[i] = swtiStringHash(variant->name);
+        if ((error = swtiHashIndexInsert(&self->nameIndex, self->nameHashes, (uint32_t) i, allocator)) < 0) {
+            return error;
+        }
+    }
+
+    return 0;
+}
+
+/***
+ * Finds a variant from its name.
+ * @param self
+ * @param name the variant name.
+ * @return the variant tag (index), or -1 if not found.
+ */
+int swtiCustomVariantTableFind(const SwtiCustomVariantTable* self, const char* name)
+{
+    SwtiHashIndexProbe probe;
+    swtiHashIndexProbeInit(&probe, &self->nameIndex, swtiStringHash(name));
+    int i;
+    while ((i = swtiHashIndexProbeNext(&probe, &self->nameIndex, self->nameHashes)) >= 0) {
+        const char* variantName = self->layouts[i].variant->name;
+        if (variantName == name || (variantName != 0 && tc_str_equal(variantName, name))) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/// name is the variant that is looked for, only used for the diagnostics
+static const SwtiCustomVariantTable* chunkVariantTable(const SwtiChunk* self, size_t customIndex, const char* name)
+{
+    size_t index = swtiChunkUnaliasIndex(self, customIndex);
+    if (index >= self->typeCount) {
+        return 0;
+    }
+    if (self->kinds[index] != SwtiTypeCustom) {
+        swtiChunkDiagnosticsReport(self, SwtiChunkDiagnosticKindMismatch, (int) customIndex, name);
+        return 0;
+    }
+
+    // Makes sure that the type (and its tables) are materialized
+    if (swtiChunkTypeFromIndex(self, index) == 0) {
+        return 0;
+    }
+
+    return self->variantTables[index];
+}
+
+/***
+ * Finds a variant in a custom type that is in the chunk. Aliases to custom types are resolved.
+ * @param self
+ * @param customIndex the type index of the custom type.
+ * @param name the variant name.
+ * @return the variant tag (index), or negative if not found. A type that is not a custom type is counted as a kind
+ * mismatch in the chunk diagnostics.
+ */
+int swtiChunkFindVariant(const SwtiChunk* self, size_t customIndex, const char* name)
+{
+    if (name == 0) {
+        return -1;
+    }
+
+    const SwtiCustomVariantTable* table = chunkVariantTable(self, customIndex, name);
+    if (table == 0) {
+        return -2;
+    }
+
+    return swtiCustomVariantTableFind(table, name);
+}
+
+/***
+ * Gets the layout for a variant from its tag.
+ * @param self
+ * @param customIndex the type index of the custom type.
+ * @param tag the variant tag (index).
+ * @return the layout, or null if the type is not a custom type or the tag is out of range.
+ */
+const SwtiVariantLayout* swtiChunkVariantLayout(const SwtiChunk* self, size_t customIndex, size_t tag)
+{
+    const SwtiCustomVariantTable* table = chunkVariantTable(self, customIndex, 0);
+    if (table == 0 || tag >= table->variantCount) {
+        return 0;
+    }
+
+    return &table->layouts[tag];
+}
@@ -4,192 +4,326 @@
  *--------------------------------------------------------------------------------------------*/
 #include <clog/clog.h>
 #include <flood/out_stream.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <swamp-typeinfo/debug.h>
 #include <swamp-typeinfo/typeinfo.h>
 
-static void printGenericParams(FldOutStream* fp, const SwtiGenericParams* params)
+/***
+ * Initializes a writer that collects the output in a small buffer and hands it over to the sink when the
+ * buffer is full.
+ * @param self
+ * @param buffer the buffer to use, can be small.
+ * @param bufferSize the size of the buffer in octets.
+ * @param sink receives the output.
+ * @param userData passed on to the sink.
+ */
+void swtiDebugWriterInit(SwtiDebugWriter* self, char* buffer, size_t bufferSize, SwtiDebugSink sink, void* userData)
+{
+    self->buffer = buffer;
+    self->bufferSize = bufferSize;
+    self->pos = 0;
+    self->sink = sink;
+    self->userData = userData;
+    self->error = 0;
+    self->parents = 0;
+}
+
+/***
+ * Hands the buffered output over to the sink.
+ * @param self
+ * @return negative on error, including errors from earlier writes.
+ */
+int swtiDebugWriterFlush(SwtiDebugWriter* self)
+{
+    if (self->pos > 0 && self->error >= 0) {
+        int error = self->sink(self->userData, self->buffer, self->pos);
+        if (error < 0) {
+            self->error = error;
+        }
+    }
+    self->pos = 0;
+
+    return self->error;
+}
+
+void swtiDebugWriterWrite(SwtiDebugWriter* self, const char* text, size_t length)
+{
+    while (length > 0 && self->error >= 0) {
+        size_t room = self->bufferSize - self->pos;
+        if (room == 0) {
+            swtiDebugWriterFlush(self);
+            continue;
+        }
+        size_t count = length < room ? length : room;
+        tc_memcpy_octets(self->buffer + self->pos, text, count);
+        self->pos += count;
+        text += count;
+        length -= count;
+    }
+}
+
+void swtiDebugWriterWrites(SwtiDebugWriter* self, const char* text)
+{
+    if (text == 0) {
+        text = "(null)";
+    }
+    swtiDebugWriterWrite(self, text, tc_strlen(text));
+}
+
+/// Only for short output, like numbers. Longer output is truncated.
+void swtiDebugWriterWritef(SwtiDebugWriter* self, const char* format, ...)
+{
+    char temp[64];
+    va_list args;
+    va_start(args, format);
+    int count = vsnprintf(temp, sizeof(temp), format, args);
+    va_end(args);
+    if (count < 0) {
+        return;
+    }
+
+    swtiDebugWriterWrite(self, temp, (size_t) count < sizeof(temp) ? (size_t) count : sizeof(temp) - 1);
+}
+
+int swtiDebugFileSink(void* userData, const char* text, size_t length)
+{
+    return fwrite(text, 1, length, (FILE*) userData) == length ? 0 : -1;
+}
+
+static int outStreamSink(void* userData, const char* text, size_t length)
+{
+    return fldOutStreamWriteOctets((FldOutStream*) userData, (const uint8_t*) text, length);
+}
+
+static void printGenericParams(SwtiDebugWriter* fp, const SwtiGenericParams* params)
 {
     if (params->genericCount == 0) {
         return;
     }
 
-    fldOutStreamWrites(fp, "<");
+    swtiDebugWriterWrites(fp, "<");
     for (size_t i = 0; i < params->genericCount; i++) {
         if (i > 0) {
-            fldOutStreamWrites(fp, " -> ");
+            swtiDebugWriterWrites(fp, " -> ");
         }
         const SwtiType* sub = params->genericTypes[i];
-        swtiDebugOutput(fp, 0, sub);
+        swtiDebugWriterWriteType(fp, 0, sub);
     }
-    fldOutStreamWrites(fp, ">");
+    swtiDebugWriterWrites(fp, ">");
 }
 
-static void printCustomTypeVariant(FldOutStream* fp, const SwtiCustomTypeVariant* variant)
+static void printCustomTypeVariant(SwtiDebugWriter* fp, const SwtiCustomTypeVariant* variant)
 {
-    fldOutStreamWritef(fp, "%s", variant->name);
+    swtiDebugWriterWrites(fp, variant->name);
     if (variant->paramCount == 0) {
         return;
     }
-    fldOutStreamWrites(fp, "(");
+    swtiDebugWriterWrites(fp, "(");
     for (size_t i = 0; i < variant->paramCount; i++) {
         if (i > 0) {
-            fldOutStreamWrites(fp, ", ");
+            swtiDebugWriterWrites(fp, ", ");
         }
         const SwtiType* sub = variant->fields[i].fieldType;
-        swtiDebugOutput(fp, 0, sub);
+        swtiDebugWriterWriteType(fp, 0, sub);
     }
-    fldOutStreamWrites(fp, ")");
+    swtiDebugWriterWrites(fp, ")");
 }
 
-static void printCustomType(FldOutStream* fp, const SwtiCustomType* custom)
+static void printCustomType(SwtiDebugWriter* fp, const SwtiCustomType* custom)
 {
-    // fldOutStreamWrites(fp, "|");
-    // fldOutStreamWritef(fp, "%s ", custom->internal.name);
-    fldOutStreamWritef(fp, "%s", custom->internal.name);
+    swtiDebugWriterWrites(fp, custom->internal.name);
     printGenericParams(fp, &custom->generic);
     if (custom->variantCount == 0) {
         return;
     }
-    fldOutStreamWritef(fp, "(");
+    swtiDebugWriterWrites(fp, "(");
     for (size_t i = 0; i < custom->variantCount; i++) {
         if (i > 0) {
-            fldOutStreamWrites(fp, " | ");
+            swtiDebugWriterWrites(fp, " | ");
         }
         const SwtiCustomTypeVariant* sub = custom->variantTypes[i];
         printCustomTypeVariant(fp, sub);
     }
-    fldOutStreamWrites(fp, ")");
+    swtiDebugWriterWrites(fp, ")");
 }
 
-static void printFunctionType(FldOutStream* fp, const SwtiFunctionType* fn)
+static void printFunctionType(SwtiDebugWriter* fp, const SwtiFunctionType* fn)
 {
-    fldOutStreamWrites(fp, "(");
+    swtiDebugWriterWrites(fp, "(");
     for (size_t i = 0; i < fn->parameterCount; i++) {
         if (i > 0) {
-            fldOutStreamWrites(fp, " -> ");
+            swtiDebugWriterWrites(fp, " -> ");
         }
         const SwtiType* sub = fn->parameterTypes[i];
-        swtiDebugOutput(fp, 0, sub);
+        swtiDebugWriterWriteType(fp, 0, sub);
     }
-    fldOutStreamWrites(fp, ")");
+    swtiDebugWriterWrites(fp, ")");
 }
 
-static void printTupleType(FldOutStream* fp, const SwtiTupleType * fn)
+static void printTupleType(SwtiDebugWriter* fp, const SwtiTupleType * fn)
 {
-    fldOutStreamWrites(fp, "(");
+    swtiDebugWriterWrites(fp, "(");
     for (size_t i = 0; i < fn->fieldCount; i++) {
         if (i > 0) {
-            fldOutStreamWrites(fp, ", ");
+            swtiDebugWriterWrites(fp, ", ");
         }
         const SwtiTupleTypeField* sub = &fn->fields[i];
-        swtiDebugOutput(fp, 0, sub->fieldType);
+        swtiDebugWriterWriteType(fp, 0, sub->fieldType);
     }
-    fldOutStreamWrites(fp, ")");
+    swtiDebugWriterWrites(fp, ")");
 }
 
-static void printAliasType(FldOutStream* fp, SwtiDebugOutputFlags flags, const SwtiAliasType* alias)
+static void printAliasType(SwtiDebugWriter* fp, SwtiDebugOutputFlags flags, const SwtiAliasType* alias)
 {
     if (flags & SwtiDebugOutputFlagsExpandAlias) {
-        fldOutStreamWritef(fp, "%s => ", alias->internal.name);
-        swtiDebugOutput(fp, flags, alias->targetType);
+        swtiDebugWriterWrites(fp, alias->internal.name);
+        swtiDebugWriterWrites(fp, " => ");
+        swtiDebugWriterWriteType(fp, flags, alias->targetType);
     } else {
-        fldOutStreamWritef(fp, "%s", alias->internal.name);
+        swtiDebugWriterWrites(fp, alias->internal.name);
     }
 }
 
-static void printTypeRefIdType(FldOutStream* fp, SwtiDebugOutputFlags flags, const SwtiTypeRefIdType* typeRefId)
+static void printTypeRefIdType(SwtiDebugWriter* fp, SwtiDebugOutputFlags flags, const SwtiTypeRefIdType* typeRefId)
 {
-    fldOutStreamWritef(fp, "$%s", typeRefId->referencedType->name);
+    swtiDebugWriterWrites(fp, "$");
+    swtiDebugWriterWrites(fp, typeRefId->referencedType->name);
 }
 
 
 
 
-static void printRecordTypeField(FldOutStream* fp, const SwtiRecordTypeField* field)
+static void printRecordTypeField(SwtiDebugWriter* fp, const SwtiRecordTypeField* field)
 {
-    fldOutStreamWritef(fp, "%s : ", field->name);
-    swtiDebugOutput(fp, 0, field->fieldType);
+    swtiDebugWriterWrites(fp, field->name);
+    swtiDebugWriterWrites(fp, " : ");
+    swtiDebugWriterWriteType(fp, 0, field->fieldType);
 }
 
-static void printRecordType(FldOutStream* fp, const SwtiRecordType* record)
+static void printRecordType(SwtiDebugWriter* fp, const SwtiRecordType* record)
 {
-    fldOutStreamWrites(fp, "{");
+    swtiDebugWriterWrites(fp, "{");
     for (size_t i = 0; i < record->fieldCount; i++) {
         if (i > 0) {
-            fldOutStreamWrites(fp, ", ");
+            swtiDebugWriterWrites(fp, ", ");
         }
         const SwtiRecordTypeField* field = &record->fields[i];
         printRecordTypeField(fp, field);
     }
-    fldOutStreamWrites(fp, "}");
+    swtiDebugWriterWrites(fp, "}");
 }
 
-static void printArrayType(FldOutStream* fp, const SwtiArrayType* array)
+static void printArrayType(SwtiDebugWriter* fp, const SwtiArrayType* array)
 {
-    fldOutStreamWrites(fp, "Array<");
-    swtiDebugOutput(fp, 0, array->itemType);
-    fldOutStreamWrites(fp, ">");
+    swtiDebugWriterWrites(fp, "Array<");
+    swtiDebugWriterWriteType(fp, 0, array->itemType);
+    swtiDebugWriterWrites(fp, ">");
 }
 
-static void printListType(FldOutStream* fp, const SwtiListType* list)
+static void printListType(SwtiDebugWriter* fp, const SwtiListType* list)
 {
-    fldOutStreamWrites(fp, "List<");
-    swtiDebugOutput(fp, 0, list->itemType);
-    fldOutStreamWrites(fp, ">");
+    swtiDebugWriterWrites(fp, "List<");
+    swtiDebugWriterWriteType(fp, 0, list->itemType);
+    swtiDebugWriterWrites(fp, ">");
 }
 
-static void printStringType(FldOutStream* fp, const SwtiStringType* string)
+static void printStringType(SwtiDebugWriter* fp, const SwtiStringType* string)
 {
-    fldOutStreamWrites(fp, "String");
+    swtiDebugWriterWrites(fp, "String");
 }
 
-static void printCharType(FldOutStream* fp, const SwtiCharType* ch)
+static void printCharType(SwtiDebugWriter* fp, const SwtiCharType* ch)
 {
-    fldOutStreamWrites(fp, "Char");
+    swtiDebugWriterWrites(fp, "Char");
 }
 
-static void printUnmanagedType(FldOutStream* fp, const SwtiUnmanagedType* unmanaged)
+static void printUnmanagedType(SwtiDebugWriter* fp, const SwtiUnmanagedType* unmanaged)
 {
-    fldOutStreamWritef(fp, "Unmanaged<%s>", unmanaged->internal.name);
+    swtiDebugWriterWrites(fp, "Unmanaged<");
+    swtiDebugWriterWrites(fp, unmanaged->internal.name);
+    swtiDebugWriterWrites(fp, ">");
 }
 
-static void printIntType(FldOutStream* fp, const SwtiIntType* intType)
+static void printIntType(SwtiDebugWriter* fp, const SwtiIntType* intType)
 {
-    fldOutStreamWrites(fp, "Int");
+    swtiDebugWriterWrites(fp, "Int");
 }
 
-static void printFixedType(FldOutStream* fp, const SwtiFixedType* fixed)
+static void printFixedType(SwtiDebugWriter* fp, const SwtiFixedType* fixed)
 {
-    fldOutStreamWrites(fp, "Fixed");
+    swtiDebugWriterWrites(fp, "Fixed");
 }
 
-static void printBoolType(FldOutStream* fp, const SwtiBooleanType* boolType)
+static void printBoolType(SwtiDebugWriter* fp, const SwtiBooleanType* boolType)
 {
-    fldOutStreamWrites(fp, "Bool");
+    swtiDebugWriterWrites(fp, "Bool");
 }
 
-static void printAnyType(FldOutStream* fp, const SwtiAnyType* any)
+static void printAnyType(SwtiDebugWriter* fp, const SwtiAnyType* any)
 {
-    fldOutStreamWrites(fp, "Any");
+    swtiDebugWriterWrites(fp, "Any");
 }
 
-static void printAnyMatchingTypesType(FldOutStream* fp, const SwtiAnyMatchingTypesType* anyMatching)
+static void printAnyMatchingTypesType(SwtiDebugWriter* fp, const SwtiAnyMatchingTypesType* anyMatching)
 {
-    fldOutStreamWrites(fp, "*");
+    swtiDebugWriterWrites(fp, "*");
 }
 
-static void printBlobType(FldOutStream* fp, const SwtiBlobType* blob)
+static void printBlobType(SwtiDebugWriter* fp, const SwtiBlobType* blob)
 {
-    fldOutStreamWrites(fp, "Blob");
+    swtiDebugWriterWrites(fp, "Blob");
 }
 
-void swtiDebugOutput(FldOutStream* fp, SwtiDebugOutputFlags flags, const SwtiType* type)
+/// A type that is already being written is on a cycle. Named types are written by name, others as the number of
+/// levels up to where the type is written.
+static int writeBackReference(SwtiDebugWriter* fp, const SwtiType* type)
+{
+    int distance = 1;
+    for (const SwtiDebugWriterParent* parent = fp->parents; parent != 0; parent = parent->parent, ++distance) {
+        if (parent->type == type) {
+            if (type->type == SwtiTypeCustom || type->type == SwtiTypeAlias) {
+                swtiDebugWriterWrites(fp, type->name);
+            } else {
+                swtiDebugWriterWritef(fp, "^%d", distance);
+            }
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void writeType(SwtiDebugWriter* fp, SwtiDebugOutputFlags flags, const SwtiType* type);
+
+/***
+ * Writes a type to the writer. The formatting is subject to change, so only use it for debugging.
+ * Recursive types are supported, see writeBackReference().
+ * @param fp
+ * @param flags
+ * @param type
+ */
+void swtiDebugWriterWriteType(SwtiDebugWriter* fp, SwtiDebugOutputFlags flags, const SwtiType* type)
 {
     uintptr_t ptrValue = (uintptr_t)(void*) type;
     if (ptrValue < 256) {
-        fldOutStreamWritef(fp, "reference: %d", ptrValue);
+        swtiDebugWriterWritef(fp, "reference: %d", (int) ptrValue);
         return;
     }
+    if (writeBackReference(fp, type)) {
+        return;
+    }
+
+    SwtiDebugWriterParent self;
+    self.type = type;
+    self.parent = fp->parents;
+    fp->parents = &self;
+    writeType(fp, flags, type);
+    fp->parents = self.parent;
+}
+
+static void writeType(SwtiDebugWriter* fp, SwtiDebugOutputFlags flags, const SwtiType* type)
+{
     switch (type->type) {
         case SwtiTypeCustom:
             printCustomType(fp, (const SwtiCustomType*) type);
@@ -246,30 +380,84 @@ void swtiDebugOutput(FldOutStream* fp, SwtiDebugOutputFlags flags, const SwtiTyp
             printUnmanagedType(fp, (const SwtiUnmanagedType*) type);
             break;
         case SwtiTypeResourceName:
-            fldOutStreamWritef(fp, "resource name %p", (const SwtiResourceNameType*) type);
+            swtiDebugWriterWritef(fp, "resource name %p", (const void*) type);
             break;
         default:
             CLOG_ERROR("swtidebugoutput unknown %d", type->type)
     }
 }
 
-char* swtiDebugString(const SwtiType* type, SwtiDebugOutputFlags flags, char* buf, size_t maxBuf)
+/***
+ * Writes a type to the sink, using a small buffer on the stack.
+ * @param sink receives the output.
+ * @param userData passed on to the sink.
+ * @param flags
+ * @param type
+ * @return negative on error.
+ */
+int swtiDebugWrite(SwtiDebugSink sink, void* userData, SwtiDebugOutputFlags flags, const SwtiType* type)
 {
-    FldOutStream outStream;
+    char buffer[SWTI_DEBUG_WRITER_BUFFER_SIZE];
+    SwtiDebugWriter writer;
+    swtiDebugWriterInit(&writer, buffer, sizeof(buffer), sink, userData);
+
+    swtiDebugWriterWriteType(&writer, flags, type);
 
-    fldOutStreamInit(&outStream, (uint8_t *) buf, maxBuf);
+    return swtiDebugWriterFlush(&writer);
+}
+
+void swtiDebugOutput(FldOutStream* fp, SwtiDebugOutputFlags flags, const SwtiType* type)
+{
+    swtiDebugWrite(outStreamSink, fp, flags, type);
+}
+
+typedef struct SwtiDebugStringTarget {
+    char* buf;
+    size_t maxBuf;
+    size_t pos;
+} SwtiDebugStringTarget;
+
+static int stringSink(void* userData, const char* text, size_t length)
+{
+    SwtiDebugStringTarget* target = (SwtiDebugStringTarget*) userData;
+    size_t room = target->maxBuf - 1 - target->pos;
+    size_t count = length < room ? length : room;
+    tc_memcpy_octets(target->buf + target->pos, text, count);
+    target->pos += count;
+
+    return 0;
+}
+
+/***
+ * Formats a type into buf. The output is truncated if it does not fit, but is always zero terminated.
+ * Use swtiDebugWrite() to stream output of any length.
+ * @param type
+ * @param flags
+ * @param buf
+ * @param maxBuf
+ * @return buf
+ */
+char* swtiDebugString(const SwtiType* type, SwtiDebugOutputFlags flags, char* buf, size_t maxBuf)
+{
+    if (maxBuf == 0) {
+        return buf;
+    }
 
-    swtiDebugOutput(&outStream, flags, type);
+    SwtiDebugStringTarget target;
+    target.buf = buf;
+    target.maxBuf = maxBuf;
+    target.pos = 0;
 
-    fldOutStreamWriteUInt8(&outStream, 0);
+    swtiDebugWrite(stringSink, &target, flags, type);
+    buf[target.pos] = 0;
 
     return buf;
 }
 
 const SwtiType* swtiUnalias(const SwtiType* maybeAlias)
 {
-    if (maybeAlias->type == SwtiTypeAlias) {
-        return swtiUnalias(((const SwtiAliasType*) maybeAlias)->targetType);
+    while (maybeAlias->type == SwtiTypeAlias) {
+        maybeAlias = ((const SwtiAliasType*) maybeAlias)->targetType;
     }
 
     return maybeAlias;
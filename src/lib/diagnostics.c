@@ -0,0 +1,89 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/diagnostics.h>
+#include <swamp-typeinfo/hash.h>
+
+void swtiChunkDiagnosticsInit(SwtiChunkDiagnostics* self)
+{
+    self->kindCollisionCount = 0;
+    self->nameMissCount = 0;
+    self->kindMismatchCount = 0;
+    self->lastCollisionIndex = -1;
+    self->lastMismatchIndex = -1;
+    self->lastMissNameHash = 0;
+    self->hook = 0;
+    self->hookUserData = 0;
+}
+
+/***
+ * Counts a diagnostic and calls the hook. Frozen chunks are shared between threads, so their counters are left
+ * alone and only the hook is called.
+ * @param chunk the chunk that the lookup was made in.
+ * @param diagnostic what went wrong.
+ * @param index the type index, see SwtiChunkDiagnosticHook.
+ * @param name the name, see SwtiChunkDiagnosticHook.
+ */
+void swtiChunkDiagnosticsReport(const SwtiChunk* chunk, SwtiChunkDiagnostic diagnostic, int index, const char* name)
+{
+    SwtiChunkDiagnostics* self = chunk->diagnostics;
+    if (self == 0) {
+        return;
+    }
+    if (!chunk->frozen) {
+        switch (diagnostic) {
+            case SwtiChunkDiagnosticKindCollision:
+                self->kindCollisionCount++;
+                self->lastCollisionIndex = index;
+                break;
+            case SwtiChunkDiagnosticNameMiss:
+                self->nameMissCount++;
+                self->lastMissNameHash = name != 0 ? swtiStringHash(name) : 0;
+                break;
+            case SwtiChunkDiagnosticKindMismatch:
+                self->kindMismatchCount++;
+                self->lastMismatchIndex = index;
+                break;
+        }
+    }
+    if (self->hook != 0) {
+        self->hook(self->hookUserData, chunk, diagnostic, index, name);
+    }
+}
+
+/***
+ * Sets the hook that is called for each diagnostic.
+ * @param self
+ * @param hook the hook, or null to only count.
+ * @param userData passed on to the hook.
+ */
+void swtiChunkSetDiagnosticHook(SwtiChunk* self, SwtiChunkDiagnosticHook hook, void* userData)
+{
+    if (self->diagnostics == 0) {
+        return;
+    }
+    self->diagnostics->hook = hook;
+    self->diagnostics->hookUserData = userData;
+}
+
+/***
+ * A hook that logs each diagnostic, for when logging is explicitly wanted.
+ */
+void swtiChunkDiagnosticLogHook(void* userData, const SwtiChunk* chunk, SwtiChunkDiagnostic diagnostic, int index,
+                                const char* name)
+{
+    switch (diagnostic) {
+        case SwtiChunkDiagnosticKindCollision:
+            CLOG_SOFT_ERROR("hash collision: '%s' collides with type %d of kind %d", name, index, chunk->kinds[index])
+            break;
+        case SwtiChunkDiagnosticNameMiss:
+            CLOG_SOFT_ERROR("couldn't find type '%s'", name)
+            break;
+        case SwtiChunkDiagnosticKindMismatch:
+            CLOG_SOFT_ERROR("type %d of kind %d has no '%s'", index, chunk->kinds[index], name != 0 ? name : "")
+            break;
+    }
+}
@@ -7,15 +7,14 @@
 #include <swamp-typeinfo/typeinfo.h>
 #include <swamp-typeinfo/equal.h>
 
-static int typeEqual(const struct SwtiType* a, const struct SwtiType* b);
-//static int typeEqual(const struct SwtiType* a, const struct SwtiType* b);
+static int typeEqual(const struct SwtiType* a, const struct SwtiType* b, SwtiTypeEqualCache* cache);
 
-static int typesEqual(const SwtiType** a, const SwtiType** b, size_t count)
+static int typesEqual(const SwtiType** a, const SwtiType** b, size_t count, SwtiTypeEqualCache* cache)
 {
     int error;
 
     for (size_t i = 0; i < count; ++i) {
-        if ((error = typeEqual(a[i], b[i])) != 0) {
+        if ((error = typeEqual(a[i], b[i], cache)) != 0) {
             return error;
         }
     }
@@ -24,6 +23,16 @@ static int typesEqual(const SwtiType** a, const SwtiType** b, size_t count)
 }
 
 
+/// Names that are interned in the same chunk are compared by pointer only.
+static int nameEqual(const char* a, const char* b)
+{
+    if (a == b) {
+        return 1;
+    }
+
+    return a != 0 && b != 0 && tc_str_equal(a, b);
+}
+
 static int memoryInfoEqual(const SwtiMemoryInfo* a, const SwtiMemoryInfo* b)
 {
     if (a->memorySize != b->memorySize) {
@@ -50,13 +59,13 @@ static int memoryOffsetInfoEqual(const SwtiMemoryOffsetInfo* a, const SwtiMemory
     return 0;
 }
 
-static int variantEqual(const SwtiCustomTypeVariant* a, const SwtiCustomTypeVariant* b)
+static int variantEqual(const SwtiCustomTypeVariant* a, const SwtiCustomTypeVariant* b, SwtiTypeEqualCache* cache)
 {
     if (a->paramCount != b->paramCount) {
         return -1;
     }
 
-    if (!tc_str_equal(a->name, b->name)) {
+    if (!nameEqual(a->name, b->name)) {
         return -2;
     }
 
@@ -65,7 +74,7 @@ static int variantEqual(const SwtiCustomTypeVariant* a, const SwtiCustomTypeVari
     }
 
     for (size_t i=0; i<a->paramCount; ++i) {
-        if (!typeEqual(a->fields[i].fieldType, b->fields[i].fieldType)) {
+        if (typeEqual(a->fields[i].fieldType, b->fields[i].fieldType, cache) != 0) {
             return -3;
         }
         if (a->fields[i].memoryOffsetInfo.memoryOffset != b->fields[i].memoryOffsetInfo.memoryOffset) {
@@ -76,7 +85,7 @@ static int variantEqual(const SwtiCustomTypeVariant* a, const SwtiCustomTypeVari
     return 0;
 }
 
-static int customEqual(const SwtiCustomType* a, const SwtiCustomType* b)
+static int customEqual(const SwtiCustomType* a, const SwtiCustomType* b, SwtiTypeEqualCache* cache)
 {
     if (a->variantCount != b->variantCount) {
         return -1;
@@ -84,7 +93,7 @@ static int customEqual(const SwtiCustomType* a, const SwtiCustomType* b)
 
     int error;
     for (size_t i = 0; i < a->variantCount; ++i) {
-        if ((error = variantEqual(a->variantTypes[i], b->variantTypes[i])) != 0) {
+        if ((error = variantEqual(a->variantTypes[i], b->variantTypes[i], cache)) != 0) {
             return error;
         }
     }
@@ -92,16 +101,16 @@ static int customEqual(const SwtiCustomType* a, const SwtiCustomType* b)
     return 0;
 }
 
-static int functionEqual(const SwtiFunctionType* a, const SwtiFunctionType* b)
+static int functionEqual(const SwtiFunctionType* a, const SwtiFunctionType* b, SwtiTypeEqualCache* cache)
 {
     if (a->parameterCount != b->parameterCount) {
         return -1;
     }
 
-    return typesEqual(a->parameterTypes, b->parameterTypes, a->parameterCount);
+    return typesEqual(a->parameterTypes, b->parameterTypes, a->parameterCount, cache);
 }
 
-static int tupleEqual(const SwtiTupleType* a, const SwtiTupleType* b)
+static int tupleEqual(const SwtiTupleType* a, const SwtiTupleType* b, SwtiTypeEqualCache* cache)
 {
     if (a->fieldCount != b->fieldCount) {
         return -1;
@@ -111,23 +120,33 @@ static int tupleEqual(const SwtiTupleType* a, const SwtiTupleType* b)
         return -3;
     }
 
-    return typesEqual(/*todo*/0,0, a->fieldCount);
+    int error;
+    for (size_t i = 0; i < a->fieldCount; ++i) {
+        if (memoryOffsetInfoEqual(&a->fields[i].memoryOffsetInfo, &b->fields[i].memoryOffsetInfo) < 0) {
+            return -4;
+        }
+        if ((error = typeEqual(a->fields[i].fieldType, b->fields[i].fieldType, cache)) != 0) {
+            return error;
+        }
+    }
+
+    return 0;
 }
 
-static int aliasEqual(const SwtiAliasType* a, const SwtiAliasType* b)
+static int aliasEqual(const SwtiAliasType* a, const SwtiAliasType* b, SwtiTypeEqualCache* cache)
 {
-    if (!tc_str_equal(a->internal.name, b->internal.name)) {
+    if (!nameEqual(a->internal.name, b->internal.name)) {
         return -1;
     }
 
-    return typeEqual(a->targetType, b->targetType);
+    return typeEqual(a->targetType, b->targetType, cache);
 }
 
 
 
-static int fieldEqual(const SwtiRecordTypeField* a, const SwtiRecordTypeField* b)
+static int fieldEqual(const SwtiRecordTypeField* a, const SwtiRecordTypeField* b, SwtiTypeEqualCache* cache)
 {
-    if (!tc_str_equal(a->name, b->name)) {
+    if (!nameEqual(a->name, b->name)) {
         return -2;
     }
 
@@ -135,10 +154,10 @@ static int fieldEqual(const SwtiRecordTypeField* a, const SwtiRecordTypeField* b
         return -3;
     }
 
-    return typeEqual(a->fieldType, b->fieldType);
+    return typeEqual(a->fieldType, b->fieldType, cache);
 }
 
-static int recordEqual(const SwtiRecordType* a, const SwtiRecordType* b)
+static int recordEqual(const SwtiRecordType* a, const SwtiRecordType* b, SwtiTypeEqualCache* cache)
 {
     if (a->fieldCount != b->fieldCount) {
         return -1;
@@ -146,7 +165,7 @@ static int recordEqual(const SwtiRecordType* a, const SwtiRecordType* b)
 
     int error;
     for (size_t i = 0; i < a->fieldCount; ++i) {
-        if ((error = fieldEqual(&a->fields[i], &b->fields[i])) != 0) {
+        if ((error = fieldEqual(&a->fields[i], &b->fields[i], cache)) != 0) {
             return error;
         }
     }
@@ -154,24 +173,24 @@ static int recordEqual(const SwtiRecordType* a, const SwtiRecordType* b)
     return 0;
 }
 
-static int arrayEqual(const SwtiArrayType* a, const SwtiArrayType* b)
+static int arrayEqual(const SwtiArrayType* a, const SwtiArrayType* b, SwtiTypeEqualCache* cache)
 {
     int memoryEqual = memoryInfoEqual(&a->memoryInfo, &b->memoryInfo);
     if (memoryEqual != 0) {
         return memoryEqual;
     }
 
-    return typeEqual(a->itemType, b->itemType);
+    return typeEqual(a->itemType, b->itemType, cache);
 }
 
-static int listEqual(const SwtiListType* a, const SwtiListType* b)
+static int listEqual(const SwtiListType* a, const SwtiListType* b, SwtiTypeEqualCache* cache)
 {
     int memoryEqual = memoryInfoEqual(&a->memoryInfo, &b->memoryInfo);
     if (memoryEqual != 0) {
         return memoryEqual;
     }
 
-    return typeEqual(a->itemType, b->itemType);
+    return typeEqual(a->itemType, b->itemType, cache);
 }
 
 static int unmanagedEqual(const SwtiUnmanagedType* a, const SwtiUnmanagedType* b)
@@ -179,48 +198,99 @@ static int unmanagedEqual(const SwtiUnmanagedType* a, const SwtiUnmanagedType* b
     if (a->userTypeId != b->userTypeId) {
         return -2;
     }
-    if (!tc_str_equal(a->internal.name, b->internal.name)) {
+    if (!nameEqual(a->internal.name, b->internal.name)) {
         return -1;
     }
 
     return 0;
 }
 
-static int typeEqual(const struct SwtiType* a, const struct SwtiType* b)
+static int isLeafType(const SwtiType* type)
+{
+    switch (type->type) {
+        case SwtiTypeCustom:
+        case SwtiTypeFunction:
+        case SwtiTypeTuple:
+        case SwtiTypeAlias:
+        case SwtiTypeRecord:
+        case SwtiTypeArray:
+        case SwtiTypeList:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+static SwtiTypeEqualCacheEntry* cacheEntry(SwtiTypeEqualCache* self, const SwtiType* a, const SwtiType* b)
+{
+    uintptr_t value = (uintptr_t) (const void*) a * 31u + (uintptr_t) (const void*) b;
+    value ^= value >> 16;
+    value *= 0x45d9f3bu;
+    value ^= value >> 16;
+
+    return &self->entries[value & (self->capacity - 1)];
+}
+
+static int compareTypes(const struct SwtiType* a, const struct SwtiType* b, SwtiTypeEqualCache* cache)
 {
+    if (a == b) {
+        return 0;
+    }
+
     if (a->type != b->type) {
         return -4;
     }
 
+    // The folded hash is only set when it is canonical: for leaf types when they are initialized, and for types that
+    // are not on a cycle when they are hashed by their chunk. Two such hashes that differ can not be equal types.
+    if (a->hash != 0 && b->hash != 0 && a->hash != b->hash) {
+        return -6;
+    }
+
+    SwtiTypeEqualCacheEntry* entry = 0;
+    if (cache != 0 && cache->capacity != 0 && !isLeafType(a)) {
+        if (b < a) {
+            const SwtiType* temp = a;
+            a = b;
+            b = temp;
+        }
+        entry = cacheEntry(cache, a, b);
+        if (entry->a == a && entry->b == b) {
+            cache->hitCount++;
+            return entry->result;
+        }
+        cache->missCount++;
+    }
+
     int error = -99;
 
     switch (a->type) {
         case SwtiTypeCustom: {
-            error = customEqual((const SwtiCustomType*) a, (const SwtiCustomType*) b);
+            error = customEqual((const SwtiCustomType*) a, (const SwtiCustomType*) b, cache);
             break;
         }
         case SwtiTypeFunction: {
-            error = functionEqual((const SwtiFunctionType*) a, (const SwtiFunctionType*) b);
+            error = functionEqual((const SwtiFunctionType*) a, (const SwtiFunctionType*) b, cache);
             break;
         }
         case SwtiTypeTuple: {
-            error = tupleEqual((const SwtiTupleType*) a, (const SwtiTupleType*) b);
+            error = tupleEqual((const SwtiTupleType*) a, (const SwtiTupleType*) b, cache);
             break;
         }
         case SwtiTypeAlias: {
-            error = aliasEqual((const SwtiAliasType*) a, (const SwtiAliasType*) b);
+            error = aliasEqual((const SwtiAliasType*) a, (const SwtiAliasType*) b, cache);
             break;
         }
         case SwtiTypeRecord: {
-            error = recordEqual((const SwtiRecordType*) a, (const SwtiRecordType*) b);
+            error = recordEqual((const SwtiRecordType*) a, (const SwtiRecordType*) b, cache);
             break;
         }
         case SwtiTypeArray: {
-            error = arrayEqual((const SwtiArrayType*) a, (const SwtiArrayType*) b);
+            error = arrayEqual((const SwtiArrayType*) a, (const SwtiArrayType*) b, cache);
             break;
         }
         case SwtiTypeList: {
-            error = listEqual((const SwtiListType*) a, (const SwtiListType*) b);
+            error = listEqual((const SwtiListType*) a, (const SwtiListType*) b, cache);
             break;
         }
         case SwtiTypeUnmanaged: {
@@ -258,9 +328,32 @@ static int typeEqual(const struct SwtiType* a, const struct SwtiType* b)
             CLOG_ERROR("typeEqual: need information about type %d", a->type)
     }
 
+    if (entry != 0) {
+        entry->a = a;
+        entry->b = b;
+        entry->result = error;
+    }
+
     return error;
 }
 
+static int typeEqual(const struct SwtiType* a, const struct SwtiType* b, SwtiTypeEqualCache* cache)
+{
+#if SWTI_CHUNK_STATS
+    if (cache != 0) {
+        cache->callCount++;
+        if (++cache->depth > cache->maxDepth) {
+            cache->maxDepth = cache->depth;
+        }
+        int result = compareTypes(a, b, cache);
+        cache->depth--;
+        return result;
+    }
+#endif
+
+    return compareTypes(a, b, cache);
+}
+
 /***
  * Checks if two types are equal
  * @param a
@@ -269,5 +362,54 @@ static int typeEqual(const struct SwtiType* a, const struct SwtiType* b)
  */
 int swtiTypeEqual(const struct SwtiType* a, const struct SwtiType* b)
 {
-    return typeEqual(a, b);
+    return typeEqual(a, b, 0);
+}
+
+/***
+ * Same as swtiTypeEqual(), but remembers the result for each compared pair of composite types in the cache,
+ * so comparing the same (sub) types again is a single lookup.
+ * @param a
+ * @param b
+ * @param cache the cache to use, can be null.
+ * @return 0 if equal or negative if the types are not equal.
+ */
+int swtiTypeEqualCached(const struct SwtiType* a, const struct SwtiType* b, SwtiTypeEqualCache* cache)
+{
+    return typeEqual(a, b, cache);
+}
+
+/***
+ * Initializes a cache for swtiTypeEqualCached(). The cache is direct mapped, so a new result overwrites an older one
+ * and the memory use never grows. The types must not be modified or freed while they are in the cache, clear it
+ * with swtiTypeEqualCacheClear() first.
+ * @param self
+ * @param entries the storage for the cache, owned by the caller.
+ * @param capacity the number of entries, must be a power of two.
+ */
+void swtiTypeEqualCacheInit(SwtiTypeEqualCache* self, SwtiTypeEqualCacheEntry* entries, size_t capacity)
+{
+    if ((capacity & (capacity - 1)) != 0) {
+        CLOG_ERROR("swtiTypeEqualCacheInit: capacity %zu must be a power of two", capacity)
+    }
+    self->entries = entries;
+    self->capacity = capacity;
+    swtiTypeEqualCacheClear(self);
+}
+
+/***
+ * Forgets all the remembered results.
+ * @param self
+ */
+void swtiTypeEqualCacheClear(SwtiTypeEqualCache* self)
+{
+    if (self->capacity > 0) {
+        tc_mem_clear_type_n(self->entries, self->capacity);
+    }
+    self->hitCount = 0;
+    self->missCount = 0;
+#if SWTI_CHUNK_STATS
+    self->callCount = 0;
+    self->depth = 0;
+    self->maxDepth = 0;
+#endif
 }
@@ -0,0 +1,308 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/hash.h>
+#include <swamp-typeinfo/typeinfo.h>
+
+#define SWTI_TYPE_HASH_SEED (0x811c9dc5u)
+#define SWTI_TYPE_HASH_BACK_REFERENCE (0x5bd1e995u)
+#define SWTI_TYPE_HASH_NO_REFERENCE ((size_t) -1)
+
+/***
+ * The types that are being hashed, from the innermost and out. Lives on the stack of typeHash().
+ */
+typedef struct SwtiTypeHashParent {
+    const SwtiType* type;
+    const struct SwtiTypeHashParent* parent;
+} SwtiTypeHashParent;
+
+/***
+ * outermostReference is the lowest depth that a back reference has pointed to in the types hashed so far.
+ */
+typedef struct SwtiTypeHashContext {
+    SwtiChunk* chunk;
+    const SwtiTypeHashMemo* memo;
+    const SwtiTypeHashParent* parents;
+    size_t depth;
+    size_t outermostReference;
+} SwtiTypeHashContext;
+
+static uint32_t hashMix(uint32_t hash, uint32_t value)
+{
+    value *= 0xcc9e2d51u;
+    value = (value << 15) | (value >> 17);
+    value *= 0x1b873593u;
+
+    hash ^= value;
+    hash = (hash << 13) | (hash >> 19);
+
+    return hash * 5u + 0xe6546b64u;
+}
+
+static uint32_t hashFinalize(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+
+    // Zero is reserved for "not calculated yet"
+    return hash == 0 ? 1 : hash;
+}
+
+static uint32_t hashString(uint32_t hash, const char* str)
+{
+    return hashMix(hash, swtiStringHash(str));
+}
+
+static uint32_t hashMemoryInfo(uint32_t hash, const SwtiMemoryInfo* info)
+{
+    return hashMix(hash, (uint32_t) info->memorySize << 8 | info->memoryAlign);
+}
+
+static uint32_t hashMemoryOffsetInfo(uint32_t hash, const SwtiMemoryOffsetInfo* info)
+{
+    return hashMemoryInfo(hashMix(hash, info->memoryOffset), &info->memoryInfo);
+}
+
+static int isInChunk(const SwtiChunk* chunk, const SwtiType* type)
+{
+    return chunk != 0 && type->index < chunk->typeCount && chunk->types[type->index] == type;
+}
+
+static uint32_t typeHash(SwtiTypeHashContext* context, const SwtiType* type);
+
+static uint32_t variantHash(SwtiTypeHashContext* context, uint32_t hash, const SwtiCustomTypeVariant* variant)
+{
+    hash = hashString(hash, variant->name);
+    hash = hashMix(hash, variant->paramCount);
+    hash = hashMemoryInfo(hash, &variant->memoryInfo);
+    for (size_t i = 0; i < variant->paramCount; ++i) {
+        hash = hashMix(hash, typeHash(context, variant->fields[i].fieldType));
+        hash = hashMix(hash, variant->fields[i].memoryOffsetInfo.memoryOffset);
+    }
+
+    return hash;
+}
+
+/// Only hashes the parts that swtiTypeEqual() compares, types that are equal must get the same hash.
+static uint32_t calculateHash(SwtiTypeHashContext* context, const SwtiType* type)
+{
+    uint32_t hash = hashMix(SWTI_TYPE_HASH_SEED, type->type);
+
+    switch (type->type) {
+        case SwtiTypeCustom: {
+            const SwtiCustomType* custom = (const SwtiCustomType*) type;
+            hash = hashMix(hash, (uint32_t) custom->variantCount);
+            for (size_t i = 0; i < custom->variantCount; ++i) {
+                hash = variantHash(context, hash, custom->variantTypes[i]);
+            }
+        } break;
+        case SwtiTypeFunction: {
+            const SwtiFunctionType* fn = (const SwtiFunctionType*) type;
+            hash = hashMix(hash, (uint32_t) fn->parameterCount);
+            for (size_t i = 0; i < fn->parameterCount; ++i) {
+                hash = hashMix(hash, typeHash(context, fn->parameterTypes[i]));
+            }
+        } break;
+        case SwtiTypeTuple: {
+            const SwtiTupleType* tuple = (const SwtiTupleType*) type;
+            hash = hashMix(hash, (uint32_t) tuple->fieldCount);
+            hash = hashMemoryInfo(hash, &tuple->memoryInfo);
+            for (size_t i = 0; i < tuple->fieldCount; ++i) {
+                hash = hashMemoryOffsetInfo(hash, &tuple->fields[i].memoryOffsetInfo);
+                hash = hashMix(hash, typeHash(context, tuple->fields[i].fieldType));
+            }
+        } break;
+        case SwtiTypeAlias: {
+            const SwtiAliasType* alias = (const SwtiAliasType*) type;
+            hash = hashString(hash, alias->internal.name);
+            hash = hashMix(hash, typeHash(context, alias->targetType));
+        } break;
+        case SwtiTypeRecord: {
+            const SwtiRecordType* record = (const SwtiRecordType*) type;
+            hash = hashMix(hash, (uint32_t) record->fieldCount);
+            for (size_t i = 0; i < record->fieldCount; ++i) {
+                const SwtiRecordTypeField* field = &record->fields[i];
+                hash = hashString(hash, field->name);
+                hash = hashMemoryOffsetInfo(hash, &field->memoryOffsetInfo);
+                hash = hashMix(hash, typeHash(context, field->fieldType));
+            }
+        } break;
+        case SwtiTypeArray: {
+            const SwtiArrayType* array = (const SwtiArrayType*) type;
+            hash = hashMemoryInfo(hash, &array->memoryInfo);
+            hash = hashMix(hash, typeHash(context, array->itemType));
+        } break;
+        case SwtiTypeList: {
+            const SwtiListType* list = (const SwtiListType*) type;
+            hash = hashMemoryInfo(hash, &list->memoryInfo);
+            hash = hashMix(hash, typeHash(context, list->itemType));
+        } break;
+        case SwtiTypeUnmanaged: {
+            const SwtiUnmanagedType* unmanaged = (const SwtiUnmanagedType*) type;
+            hash = hashMix(hash, unmanaged->userTypeId);
+            hash = hashString(hash, unmanaged->internal.name);
+        } break;
+        default:
+            break;
+    }
+
+    return hash;
+}
+
+static uint32_t typeHash(SwtiTypeHashContext* context, const SwtiType* type)
+{
+    uintptr_t ptrValue = (uintptr_t)(const void*) type;
+    if (ptrValue < 256) {
+        // Unresolved type reference, see swtiDebugOutput()
+        return hashFinalize(hashMix(SWTI_TYPE_HASH_SEED, (uint32_t) ptrValue));
+    }
+
+    // The folded hash is only set for types that are not on a cycle, see below
+    int isRegistered = isInChunk(context->chunk, type);
+    if (isRegistered && type->hash != 0 && context->chunk->hashes[type->index] != 0) {
+        return context->chunk->hashes[type->index];
+    }
+
+    if (!isRegistered && context->memo != 0) {
+        uint32_t remembered = context->memo->find(context->memo->userData, type);
+        if (remembered != 0) {
+            return remembered;
+        }
+    }
+
+    uint32_t distance = 1;
+    for (const SwtiTypeHashParent* parent = context->parents; parent != 0; parent = parent->parent, ++distance) {
+        if (parent->type == type) {
+            size_t referencedDepth = context->depth - distance;
+            if (referencedDepth < context->outermostReference) {
+                context->outermostReference = referencedDepth;
+            }
+            return hashFinalize(hashMix(SWTI_TYPE_HASH_BACK_REFERENCE, distance));
+        }
+    }
+
+    size_t depth = context->depth;
+    size_t outerReference = context->outermostReference;
+    SwtiTypeHashParent self;
+    self.type = type;
+    self.parent = context->parents;
+
+    context->outermostReference = SWTI_TYPE_HASH_NO_REFERENCE;
+    context->parents = &self;
+    context->depth++;
+    uint32_t hash = hashFinalize(calculateHash(context, type));
+    context->depth--;
+    context->parents = self.parent;
+
+    // A back reference to the type itself, or to one of its parents, means that the type is on a cycle. The hash of
+    // such a type depends on where the walk entered the cycle, so it can not be reused when hashing other types.
+    int isOnCycle = context->outermostReference <= depth;
+    if (outerReference < context->outermostReference) {
+        context->outermostReference = outerReference;
+    }
+
+    if (isRegistered && !isOnCycle) {
+        // The hashes of a chunk that was initialized from an image point into the image, so only write missing ones
+        if (context->chunk->hashes[type->index] == 0) {
+            context->chunk->hashes[type->index] = hash;
+        }
+        ((SwtiType*) type)->hash = swtiTypeHashFold(hash);
+    } else if (!isOnCycle && context->memo != 0) {
+        context->memo->store(context->memo->userData, type, hash);
+    }
+
+    return hash;
+}
+
+static void contextInit(SwtiTypeHashContext* self, SwtiChunk* chunk, const SwtiTypeHashMemo* memo)
+{
+    self->chunk = chunk;
+    self->memo = memo;
+    self->parents = 0;
+    self->depth = 0;
+    self->outermostReference = SWTI_TYPE_HASH_NO_REFERENCE;
+}
+
+/***
+ * Calculates the structural hash for a type. Types that are equal according to swtiTypeEqual() get the same hash.
+ * @param type the type to hash.
+ * @return the hash, never zero.
+ */
+uint32_t swtiTypeHash(const SwtiType* type)
+{
+    SwtiTypeHashContext context;
+    contextInit(&context, 0, 0);
+
+    return typeHash(&context, type);
+}
+
+/***
+ * Same as swtiTypeHash(), but reuses (and stores) the hashes for types that are contained in the chunk.
+ * The hashes of types that are on a cycle are only stored for the type itself, they are never reused while hashing
+ * other types, since they depend on where the cycle was entered. That way the hash of a type never depends on which
+ * types that happened to be hashed before it.
+ * @param chunk the chunk that caches the hashes.
+ * @param type the type to hash.
+ * @return the hash, never zero.
+ */
+uint32_t swtiChunkTypeHash(SwtiChunk* chunk, const SwtiType* type)
+{
+    return swtiChunkTypeHashWithMemo(chunk, type, 0);
+}
+
+/***
+ * Same as swtiChunkTypeHash(), but also reuses (and stores) the hashes for types that are not contained in the chunk.
+ * @param chunk the chunk that caches the hashes. Can be zero.
+ * @param type the type to hash.
+ * @param memo remembers the hashes of the types that are not in the chunk. Can be zero.
+ * @return the hash, never zero.
+ */
+uint32_t swtiChunkTypeHashWithMemo(SwtiChunk* chunk, const SwtiType* type, const SwtiTypeHashMemo* memo)
+{
+    SwtiTypeHashContext context;
+    contextInit(&context, chunk, memo);
+
+    uint32_t hash = typeHash(&context, type);
+    if (isInChunk(chunk, type) && chunk->hashes[type->index] == 0) {
+        chunk->hashes[type->index] = hash;
+    }
+
+    return hash;
+}
+
+/***
+ * Folds a structural hash into the 16 bits that fits in SwtiType::hash.
+ * @param hash the structural hash.
+ * @return the folded hash, never zero.
+ */
+uint16_t swtiTypeHashFold(uint32_t hash)
+{
+    uint16_t folded = (uint16_t) (hash ^ (hash >> 16));
+
+    return folded == 0 ? 1 : folded;
+}
+
+/***
+ * Calculates a FNV-1a hash for a string.
+ * @param str the string to hash, can be null.
+ * @return the hash, zero for a null string and never zero for other strings.
+ */
+uint32_t swtiStringHash(const char* str)
+{
+    if (str == 0) {
+        return 0;
+    }
+
+    uint32_t hash = SWTI_TYPE_HASH_SEED;
+    for (const char* p = str; *p != 0; ++p) {
+        hash ^= (uint8_t) *p;
+        hash *= 0x01000193u;
+    }
+
+    return hash == 0 ? 1 : hash;
+}
@@ -0,0 +1,128 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <swamp-typeinfo/hash.h>
+
+#define SWTI_HASH_INDEX_MIN_CAPACITY (16)
+
+static void insertSlot(uint32_t* slots, size_t capacity, uint32_t hash, uint32_t value)
+{
+    size_t mask = capacity - 1;
+    size_t slot = hash & mask;
+    while (slots[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+
+    // Zero is reserved for empty slots
+    slots[slot] = value + 1;
+}
+
+/***
+ * Initializes an empty index. No memory is allocated until the first insert.
+ * @param self
+ */
+void swtiHashIndexInit(SwtiHashIndex* self)
+{
+    self->slots = 0;
+    self->capacity = 0;
+    self->count = 0;
+}
+
+/***
+ * Grows the slot table so @p count values fit without a later insert having to allocate.
+ * @param self
+ * @param keys the hashes for all inserted values, indexed by value.
+ * @param count the total number of values the index should hold.
+ * @param allocator the allocator to use when growing the slot table.
+ * @return negative on error, the index is then unchanged.
+ */
+int swtiHashIndexReserve(SwtiHashIndex* self, const uint32_t* keys, size_t count, struct ImprintAllocator* allocator)
+{
+    if (count * 2 <= self->capacity) {
+        return 0;
+    }
+
+    size_t newCapacity = self->capacity == 0 ? SWTI_HASH_INDEX_MIN_CAPACITY : self->capacity;
+    while (count * 2 > newCapacity) {
+        newCapacity *= 2;
+    }
+
+    uint32_t* newSlots = IMPRINT_CALLOC_TYPE_COUNT(allocator, uint32_t, newCapacity);
+    if (newSlots == 0) {
+        CLOG_ERROR("swtiHashIndexReserve: out of memory")
+        return -1;
+    }
+    for (size_t i = 0; i < self->capacity; ++i) {
+        uint32_t slotValue = self->slots[i];
+        if (slotValue != 0) {
+            insertSlot(newSlots, newCapacity, keys[slotValue - 1], slotValue - 1);
+        }
+    }
+    self->slots = newSlots;
+    self->capacity = newCapacity;
+
+    return 0;
+}
+
+/***
+ * Inserts a value into the index. The slot table grows (doubles) to keep the load factor at or below 0.5.
+ * Can not fail if swtiHashIndexReserve() has made room for the value.
+ * @param self
+ * @param keys the hashes for all inserted values, indexed by value. keys[value] must be valid.
+ * @param value the value to insert.
+ * @param allocator the allocator to use when growing the slot table.
+ * @return negative on error.
+ */
+int swtiHashIndexInsert(SwtiHashIndex* self, const uint32_t* keys, uint32_t value, struct ImprintAllocator* allocator)
+{
+    int error;
+    if ((error = swtiHashIndexReserve(self, keys, self->count + 1, allocator)) < 0) {
+        return error;
+    }
+
+    insertSlot(self->slots, self->capacity, keys[value], value);
+    self->count++;
+
+    return 0;
+}
+
+/***
+ * Prepares a probe that iterates over all values with the specified hash.
+ * @param probe
+ * @param self
+ * @param hash the hash to search for.
+ */
+void swtiHashIndexProbeInit(SwtiHashIndexProbe* probe, const SwtiHashIndex* self, uint32_t hash)
+{
+    probe->hash = hash;
+    probe->slot = self->capacity == 0 ? 0 : hash & (self->capacity - 1);
+}
+
+/***
+ * Returns the next value that has the probed hash.
+ * @param probe
+ * @param self
+ * @param keys the hashes for all inserted values, indexed by value.
+ * @return the value or -1 if there are no more values with that hash.
+ */
+int swtiHashIndexProbeNext(SwtiHashIndexProbe* probe, const SwtiHashIndex* self, const uint32_t* keys)
+{
+    if (self->capacity == 0) {
+        return -1;
+    }
+
+    size_t mask = self->capacity - 1;
+    for (;;) {
+        uint32_t slotValue = self->slots[probe->slot];
+        if (slotValue == 0) {
+            return -1;
+        }
+        probe->slot = (probe->slot + 1) & mask;
+        if (keys[slotValue - 1] == probe->hash) {
+            return (int) (slotValue - 1);
+        }
+    }
+}
@@ -0,0 +1,655 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <flood/out_stream.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/image.h>
+#include <swamp-typeinfo/typeinfo.h>
+
+#if !defined _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SWTI_IMAGE_ALIGN(x) (((x) + 7) & ~(size_t) 7)
+
+typedef enum SwtiImageWriterMode {
+    SwtiImageWriterModeCount,
+    SwtiImageWriterModeWrite,
+    SwtiImageWriterModeStrings
+} SwtiImageWriterMode;
+
+typedef struct SwtiImageWriter {
+    const SwtiChunk* chunk;
+    FldOutStream* out;
+    SwtiImageWriterMode mode;
+    uint32_t itemIndex;
+    uint32_t stringOffset;
+    int error;
+} SwtiImageWriter;
+
+static void writeOctets(SwtiImageWriter* writer, const void* octets, size_t count)
+{
+    if (writer->error < 0) {
+        return;
+    }
+    int error = fldOutStreamWriteOctets(writer->out, (const uint8_t*) octets, count);
+    if (error < 0) {
+        writer->error = error;
+    }
+}
+
+static void writePadding(SwtiImageWriter* writer, size_t count)
+{
+    static const uint8_t zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t padding = SWTI_IMAGE_ALIGN(count) - count;
+    if (padding > 0) {
+        writeOctets(writer, zeros, padding);
+    }
+}
+
+static uint32_t writerString(SwtiImageWriter* writer, const char* str)
+{
+    if (str == 0) {
+        return SWTI_IMAGE_NONE;
+    }
+
+    uint32_t offset = writer->stringOffset;
+    size_t octetCount = tc_strlen(str) + 1;
+    if (writer->mode == SwtiImageWriterModeStrings) {
+        writeOctets(writer, str, octetCount);
+    }
+    writer->stringOffset += (uint32_t) octetCount;
+
+    return offset;
+}
+
+static void writerItem(SwtiImageWriter* writer, const SwtiImageItem* item)
+{
+    if (writer->mode == SwtiImageWriterModeWrite) {
+        writeOctets(writer, item, sizeof(*item));
+    }
+    writer->itemIndex++;
+}
+
+static uint32_t typeRef(SwtiImageWriter* writer, const SwtiType* type)
+{
+    const SwtiChunk* chunk = writer->chunk;
+    uintptr_t ptrValue = (uintptr_t)(const void*) type;
+    if (ptrValue < 256 || type->index >= chunk->typeCount || chunk->types[type->index] != type) {
+        CLOG_SOFT_ERROR("swtiChunkImageWrite: referenced type is not in the chunk")
+        writer->error = -2;
+        return SWTI_IMAGE_NONE;
+    }
+
+    return type->index;
+}
+
+static void setMemoryOffsetInfo(SwtiImageItem* item, const SwtiMemoryOffsetInfo* info)
+{
+    item->memoryOffset = info->memoryOffset;
+    item->memorySize = info->memoryInfo.memorySize;
+    item->memoryAlign = info->memoryInfo.memoryAlign;
+}
+
+/// Emits the items for a type. Custom types first emit all the variants, and then the fields for each variant.
+static void writerItems(SwtiImageWriter* writer, const SwtiType* type)
+{
+    SwtiImageItem item;
+
+    switch (type->type) {
+        case SwtiTypeRecord: {
+            const SwtiRecordType* record = (const SwtiRecordType*) type;
+            for (size_t i = 0; i < record->fieldCount; ++i) {
+                tc_mem_clear_type(&item);
+                item.ref = typeRef(writer, record->fields[i].fieldType);
+                item.name = writerString(writer, record->fields[i].name);
+                setMemoryOffsetInfo(&item, &record->fields[i].memoryOffsetInfo);
+                writerItem(writer, &item);
+            }
+        } break;
+        case SwtiTypeTuple: {
+            const SwtiTupleType* tuple = (const SwtiTupleType*) type;
+            for (size_t i = 0; i < tuple->fieldCount; ++i) {
+                tc_mem_clear_type(&item);
+                item.ref = typeRef(writer, tuple->fields[i].fieldType);
+                item.name = writerString(writer, tuple->fields[i].name);
+                setMemoryOffsetInfo(&item, &tuple->fields[i].memoryOffsetInfo);
+                writerItem(writer, &item);
+            }
+        } break;
+        case SwtiTypeFunction: {
+            const SwtiFunctionType* fn = (const SwtiFunctionType*) type;
+            for (size_t i = 0; i < fn->parameterCount; ++i) {
+                tc_mem_clear_type(&item);
+                item.ref = typeRef(writer, fn->parameterTypes[i]);
+                item.name = SWTI_IMAGE_NONE;
+                writerItem(writer, &item);
+            }
+        } break;
+        case SwtiTypeCustom: {
+            const SwtiCustomType* custom = (const SwtiCustomType*) type;
+            uint32_t fieldItemIndex = writer->itemIndex + (uint32_t) custom->variantCount;
+            for (size_t i = 0; i < custom->variantCount; ++i) {
+                const SwtiCustomTypeVariant* variant = custom->variantTypes[i];
+                tc_mem_clear_type(&item);
+                item.ref = fieldItemIndex;
+                item.name = writerString(writer, variant->name);
+                item.count = variant->paramCount;
+                item.memorySize = variant->memoryInfo.memorySize;
+                item.memoryAlign = variant->memoryInfo.memoryAlign;
+                writerItem(writer, &item);
+                fieldItemIndex += variant->paramCount;
+            }
+            for (size_t i = 0; i < custom->variantCount; ++i) {
+                const SwtiCustomTypeVariant* variant = custom->variantTypes[i];
+                for (size_t j = 0; j < variant->paramCount; ++j) {
+                    tc_mem_clear_type(&item);
+                    item.ref = typeRef(writer, variant->fields[j].fieldType);
+                    item.name = SWTI_IMAGE_NONE;
+                    setMemoryOffsetInfo(&item, &variant->fields[j].memoryOffsetInfo);
+                    writerItem(writer, &item);
+                }
+            }
+        } break;
+        default:
+            break;
+    }
+}
+
+static void walkType(SwtiImageWriter* writer, const SwtiType* type)
+{
+    writerString(writer, type->name);
+    writerItems(writer, type);
+}
+
+static void fillEntry(SwtiImageWriter* writer, SwtiImageEntry* entry, const SwtiType* type)
+{
+    const SwtiMemoryInfo* memoryInfo = 0;
+
+    tc_mem_clear_type(entry);
+    entry->type = (uint8_t) type->type;
+    entry->name = writerString(writer, type->name);
+    entry->target = SWTI_IMAGE_NONE;
+    entry->firstItem = writer->itemIndex;
+
+    switch (type->type) {
+        case SwtiTypeRecord:
+            memoryInfo = &((const SwtiRecordType*) type)->memoryInfo;
+            entry->itemCount = (uint32_t) ((const SwtiRecordType*) type)->fieldCount;
+            break;
+        case SwtiTypeTuple:
+            memoryInfo = &((const SwtiTupleType*) type)->memoryInfo;
+            entry->itemCount = (uint32_t) ((const SwtiTupleType*) type)->fieldCount;
+            break;
+        case SwtiTypeCustom:
+            memoryInfo = &((const SwtiCustomType*) type)->memoryInfo;
+            entry->itemCount = (uint32_t) ((const SwtiCustomType*) type)->variantCount;
+            break;
+        case SwtiTypeFunction:
+            entry->itemCount = (uint32_t) ((const SwtiFunctionType*) type)->parameterCount;
+            break;
+        case SwtiTypeArray:
+            memoryInfo = &((const SwtiArrayType*) type)->memoryInfo;
+            entry->target = typeRef(writer, ((const SwtiArrayType*) type)->itemType);
+            break;
+        case SwtiTypeList:
+            memoryInfo = &((const SwtiListType*) type)->memoryInfo;
+            entry->target = typeRef(writer, ((const SwtiListType*) type)->itemType);
+            break;
+        case SwtiTypeAlias:
+            entry->target = typeRef(writer, ((const SwtiAliasType*) type)->targetType);
+            break;
+        case SwtiTypeRefId:
+            entry->target = typeRef(writer, ((const SwtiTypeRefIdType*) type)->referencedType);
+            break;
+        case SwtiTypeUnmanaged:
+            entry->target = ((const SwtiUnmanagedType*) type)->userTypeId;
+            break;
+        default:
+            break;
+    }
+
+    if (memoryInfo != 0) {
+        entry->memorySize = memoryInfo->memorySize;
+        entry->memoryAlign = memoryInfo->memoryAlign;
+    }
+}
+
+static void countTypes(SwtiImageWriter* writer)
+{
+    SwtiImageEntry entry;
+    for (size_t i = 0; i < writer->chunk->typeCount; ++i) {
+        fillEntry(writer, &entry, swtiChunkTypeFromIndex(writer->chunk, i));
+        writerItems(writer, swtiChunkTypeFromIndex(writer->chunk, i));
+    }
+}
+
+static void fillHeader(const SwtiChunk* chunk, SwtiImageHeader* header, uint32_t itemCount, uint32_t stringsSize)
+{
+    size_t typeCount = chunk->typeCount;
+    size_t offset = SWTI_IMAGE_ALIGN(sizeof(SwtiImageHeader));
+
+    tc_mem_clear_type(header);
+    header->magic = SWTI_IMAGE_MAGIC;
+    header->version = SWTI_IMAGE_VERSION;
+    header->entrySize = sizeof(SwtiImageEntry);
+    header->typeCount = (uint32_t) typeCount;
+    header->itemCount = itemCount;
+    header->stringsSize = stringsSize;
+    header->hashSlotCapacity = (uint32_t) chunk->hashIndex.capacity;
+    header->nameSlotCapacity = (uint32_t) chunk->nameIndex.capacity;
+
+    header->entriesOffset = (uint32_t) offset;
+    offset += SWTI_IMAGE_ALIGN(typeCount * sizeof(SwtiImageEntry));
+    header->hashesOffset = (uint32_t) offset;
+    offset += SWTI_IMAGE_ALIGN(typeCount * sizeof(uint32_t));
+    header->nameHashesOffset = (uint32_t) offset;
+    offset += SWTI_IMAGE_ALIGN(typeCount * sizeof(uint32_t));
+    header->kindsOffset = (uint32_t) offset;
+    offset += SWTI_IMAGE_ALIGN(typeCount * sizeof(uint8_t));
+    header->layoutsOffset = (uint32_t) offset;
+    offset += SWTI_IMAGE_ALIGN(typeCount * sizeof(SwtiMemoryInfo));
+    header->unaliasedOffset = (uint32_t) offset;
+    offset += SWTI_IMAGE_ALIGN(typeCount * sizeof(uint32_t));
+    header->hashSlotsOffset = (uint32_t) offset;
+    offset += SWTI_IMAGE_ALIGN(header->hashSlotCapacity * sizeof(uint32_t));
+    header->nameSlotsOffset = (uint32_t) offset;
+    offset += SWTI_IMAGE_ALIGN(header->nameSlotCapacity * sizeof(uint32_t));
+    header->itemsOffset = (uint32_t) offset;
+    offset += SWTI_IMAGE_ALIGN(itemCount * sizeof(SwtiImageItem));
+    header->stringsOffset = (uint32_t) offset;
+    offset += SWTI_IMAGE_ALIGN(stringsSize);
+    header->octetCount = (uint32_t) offset;
+}
+
+static void prepareHeader(const SwtiChunk* chunk, SwtiImageHeader* header)
+{
+    SwtiImageWriter writer;
+    writer.chunk = chunk;
+    writer.out = 0;
+    writer.mode = SwtiImageWriterModeCount;
+    writer.itemIndex = 0;
+    writer.stringOffset = 0;
+    writer.error = 0;
+
+    countTypes(&writer);
+
+    fillHeader(chunk, header, writer.itemIndex, writer.stringOffset);
+}
+
+/***
+ * Calculates the number of octets that swtiChunkImageWrite() will write for the chunk.
+ * @param chunk
+ * @return the octet count.
+ */
+size_t swtiChunkImageOctetCount(const SwtiChunk* chunk)
+{
+    SwtiImageHeader header;
+    prepareHeader(chunk, &header);
+
+    return header.octetCount;
+}
+
+/***
+ * Serializes the chunk into an image that can be used in place with swtiChunkImageInit().
+ * All types that are referenced must be contained in the chunk.
+ * @param chunk the chunk to serialize.
+ * @param out the stream to write to. Must fit swtiChunkImageOctetCount() octets.
+ * @return negative on error.
+ */
+int swtiChunkImageWrite(const SwtiChunk* chunk, FldOutStream* out)
+{
+    SwtiImageHeader header;
+    prepareHeader(chunk, &header);
+
+    SwtiImageWriter writer;
+    writer.chunk = chunk;
+    writer.out = out;
+    writer.mode = SwtiImageWriterModeWrite;
+    writer.itemIndex = 0;
+    writer.stringOffset = 0;
+    writer.error = 0;
+
+    size_t typeCount = chunk->typeCount;
+
+    writeOctets(&writer, &header, sizeof(header));
+    writePadding(&writer, sizeof(header));
+
+    for (size_t i = 0; i < typeCount; ++i) {
+        SwtiImageEntry entry;
+        const SwtiType* type = swtiChunkTypeFromIndex(chunk, i);
+        fillEntry(&writer, &entry, type);
+        writeOctets(&writer, &entry, sizeof(entry));
+        // Only counting the items here, to get the correct first item for the next entry
+        writer.mode = SwtiImageWriterModeCount;
+        writerItems(&writer, type);
+        writer.mode = SwtiImageWriterModeWrite;
+    }
+    writePadding(&writer, typeCount * sizeof(SwtiImageEntry));
+
+    writeOctets(&writer, chunk->hashes, typeCount * sizeof(uint32_t));
+    writePadding(&writer, typeCount * sizeof(uint32_t));
+    writeOctets(&writer, chunk->nameHashes, typeCount * sizeof(uint32_t));
+    writePadding(&writer, typeCount * sizeof(uint32_t));
+    writeOctets(&writer, chunk->kinds, typeCount * sizeof(uint8_t));
+    writePadding(&writer, typeCount * sizeof(uint8_t));
+    for (size_t i = 0; i < typeCount; ++i) {
+        // Copied field by field, so the padding in the struct is always zero
+        SwtiMemoryInfo layout;
+        tc_mem_clear_type(&layout);
+        layout.memorySize = chunk->layouts[i].memorySize;
+        layout.memoryAlign = chunk->layouts[i].memoryAlign;
+        writeOctets(&writer, &layout, sizeof(layout));
+    }
+    writePadding(&writer, typeCount * sizeof(SwtiMemoryInfo));
+    writeOctets(&writer, chunk->unaliased, typeCount * sizeof(uint32_t));
+    writePadding(&writer, typeCount * sizeof(uint32_t));
+    writeOctets(&writer, chunk->hashIndex.slots, header.hashSlotCapacity * sizeof(uint32_t));
+    writePadding(&writer, header.hashSlotCapacity * sizeof(uint32_t));
+    writeOctets(&writer, chunk->nameIndex.slots, header.nameSlotCapacity * sizeof(uint32_t));
+    writePadding(&writer, header.nameSlotCapacity * sizeof(uint32_t));
+
+    // Strings are laid out as the type name followed by the item names, for each type
+    writer.itemIndex = 0;
+    writer.stringOffset = 0;
+    for (size_t i = 0; i < typeCount; ++i) {
+        walkType(&writer, swtiChunkTypeFromIndex(chunk, i));
+    }
+    writePadding(&writer, header.itemCount * sizeof(SwtiImageItem));
+
+    writer.mode = SwtiImageWriterModeStrings;
+    writer.itemIndex = 0;
+    writer.stringOffset = 0;
+    for (size_t i = 0; i < typeCount; ++i) {
+        walkType(&writer, swtiChunkTypeFromIndex(chunk, i));
+    }
+    writePadding(&writer, header.stringsSize);
+
+    if (writer.error < 0) {
+        CLOG_SOFT_ERROR("swtiChunkImageWrite: could not write image %d", writer.error)
+    }
+
+    return writer.error;
+}
+
+static int sectionIsValid(size_t octetCount, uint32_t offset, size_t count, size_t itemSize)
+{
+    return (offset & 7) == 0 && offset <= octetCount && count <= (octetCount - offset) / itemSize;
+}
+
+/***
+ * Uses a serialized image in place. Only the header is validated, so the initialization does not touch
+ * the rest of the pages. The image must come from a trusted source (swtiChunkImageWrite()).
+ * The octets must be eight byte aligned and outlive the image.
+ * @param self
+ * @param octets the image octets, written by swtiChunkImageWrite().
+ * @param octetCount the number of octets.
+ * @return negative on error.
+ */
+int swtiChunkImageInit(SwtiChunkImage* self, const void* octets, size_t octetCount)
+{
+    const SwtiImageHeader* header = (const SwtiImageHeader*) octets;
+
+    tc_mem_clear_type(self);
+
+    if (((uintptr_t) octets & 7) != 0 || octetCount < sizeof(SwtiImageHeader)) {
+        CLOG_SOFT_ERROR("swtiChunkImageInit: image is not aligned or too small")
+        return -1;
+    }
+
+    if (header->magic != SWTI_IMAGE_MAGIC) {
+        CLOG_SOFT_ERROR("swtiChunkImageInit: wrong magic or byte order %08X", header->magic)
+        return -2;
+    }
+
+    if (header->version != SWTI_IMAGE_VERSION || header->entrySize != sizeof(SwtiImageEntry)) {
+        CLOG_SOFT_ERROR("swtiChunkImageInit: unsupported version %d", header->version)
+        return -3;
+    }
+
+    if (header->octetCount > octetCount || !sectionIsValid(octetCount, header->entriesOffset, header->typeCount, sizeof(SwtiImageEntry)) ||
+        !sectionIsValid(octetCount, header->hashesOffset, header->typeCount, sizeof(uint32_t)) ||
+        !sectionIsValid(octetCount, header->nameHashesOffset, header->typeCount, sizeof(uint32_t)) ||
+        !sectionIsValid(octetCount, header->kindsOffset, header->typeCount, sizeof(uint8_t)) ||
+        !sectionIsValid(octetCount, header->layoutsOffset, header->typeCount, sizeof(SwtiMemoryInfo)) ||
+        !sectionIsValid(octetCount, header->unaliasedOffset, header->typeCount, sizeof(uint32_t)) ||
+        !sectionIsValid(octetCount, header->hashSlotsOffset, header->hashSlotCapacity, sizeof(uint32_t)) ||
+        !sectionIsValid(octetCount, header->nameSlotsOffset, header->nameSlotCapacity, sizeof(uint32_t)) ||
+        !sectionIsValid(octetCount, header->itemsOffset, header->itemCount, sizeof(SwtiImageItem)) ||
+        !sectionIsValid(octetCount, header->stringsOffset, header->stringsSize, 1)) {
+        CLOG_SOFT_ERROR("swtiChunkImageInit: section is out of bounds")
+        return -4;
+    }
+
+    if ((header->hashSlotCapacity & (header->hashSlotCapacity - 1)) != 0 ||
+        (header->nameSlotCapacity & (header->nameSlotCapacity - 1)) != 0) {
+        CLOG_SOFT_ERROR("swtiChunkImageInit: slot capacity must be a power of two")
+        return -5;
+    }
+
+    const uint8_t* base = (const uint8_t*) octets;
+    self->strings = (const char*) (base + header->stringsOffset);
+    if (header->stringsSize > 0 && self->strings[header->stringsSize - 1] != 0) {
+        CLOG_SOFT_ERROR("swtiChunkImageInit: strings are not terminated")
+        return -6;
+    }
+
+    self->octets = base;
+    self->octetCount = octetCount;
+    self->header = header;
+    self->entries = (const SwtiImageEntry*) (base + header->entriesOffset);
+    self->hashes = (const uint32_t*) (base + header->hashesOffset);
+    self->nameHashes = (const uint32_t*) (base + header->nameHashesOffset);
+    self->kinds = base + header->kindsOffset;
+    self->layouts = (const SwtiMemoryInfo*) (base + header->layoutsOffset);
+    self->unaliased = (const uint32_t*) (base + header->unaliasedOffset);
+    self->items = (const SwtiImageItem*) (base + header->itemsOffset);
+
+    self->hashIndex.slots = (uint32_t*) (base + header->hashSlotsOffset);
+    self->hashIndex.capacity = header->hashSlotCapacity;
+    self->hashIndex.count = header->typeCount;
+    self->nameIndex.slots = (uint32_t*) (base + header->nameSlotsOffset);
+    self->nameIndex.capacity = header->nameSlotCapacity;
+    self->nameIndex.count = header->typeCount;
+
+    return 0;
+}
+
+/***
+ * Memory maps an image file and uses it in place. Pages are only read when they are touched.
+ * @param self
+ * @param filename the file to map.
+ * @return negative on error.
+ */
+int swtiChunkImageMapFile(SwtiChunkImage* self, const char* filename)
+{
+#if defined _WIN32
+    CLOG_SOFT_ERROR("swtiChunkImageMapFile: memory mapping is not supported on this platform")
+    return -1;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        CLOG_SOFT_ERROR("swtiChunkImageMapFile: could not open '%s'", filename)
+        return -1;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) < 0 || fileStat.st_size <= 0) {
+        close(fd);
+        CLOG_SOFT_ERROR("swtiChunkImageMapFile: could not stat '%s'", filename)
+        return -2;
+    }
+
+    size_t octetCount = (size_t) fileStat.st_size;
+    void* mapping = mmap(0, octetCount, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        CLOG_SOFT_ERROR("swtiChunkImageMapFile: could not map '%s'", filename)
+        return -3;
+    }
+
+    int error;
+    if ((error = swtiChunkImageInit(self, mapping, octetCount)) < 0) {
+        munmap(mapping, octetCount);
+        return error;
+    }
+
+    self->mapping = mapping;
+    self->mappingSize = octetCount;
+
+    return 0;
+#endif
+}
+
+/***
+ * Unmaps the image if it was mapped with swtiChunkImageMapFile().
+ * @param self
+ */
+void swtiChunkImageDestroy(SwtiChunkImage* self)
+{
+#if !defined _WIN32
+    if (self->mapping != 0) {
+        munmap(self->mapping, self->mappingSize);
+    }
+#endif
+    tc_mem_clear_type(self);
+}
+
+size_t swtiChunkImageTypeCount(const SwtiChunkImage* self)
+{
+    return self->header == 0 ? 0 : self->header->typeCount;
+}
+
+/***
+ * Returns the entry for a type index.
+ * @param self
+ * @param index zero based type index.
+ * @return the entry, or 0 if the index is out of range.
+ */
+const SwtiImageEntry* swtiChunkImageEntry(const SwtiChunkImage* self, size_t index)
+{
+    if (index >= swtiChunkImageTypeCount(self)) {
+        return 0;
+    }
+
+    return &self->entries[index];
+}
+
+/***
+ * Returns the items for an entry, the count is in SwtiImageEntry::itemCount.
+ * @param self
+ * @param entry
+ * @return the first item, or 0 if the item range is out of bounds.
+ */
+const SwtiImageItem* swtiChunkImageItems(const SwtiChunkImage* self, const SwtiImageEntry* entry)
+{
+    if (entry->firstItem > self->header->itemCount || entry->itemCount > self->header->itemCount - entry->firstItem) {
+        return 0;
+    }
+
+    return &self->items[entry->firstItem];
+}
+
+/***
+ * Returns the fields for a custom type variant item, the count is in SwtiImageItem::count.
+ * @param self
+ * @param variant
+ * @return the first field, or 0 if the item range is out of bounds.
+ */
+const SwtiImageItem* swtiChunkImageVariantFields(const SwtiChunkImage* self, const SwtiImageItem* variant)
+{
+    if (variant->ref > self->header->itemCount || variant->count > self->header->itemCount - variant->ref) {
+        return 0;
+    }
+
+    return &self->items[variant->ref];
+}
+
+/***
+ * Returns a string from the string section.
+ * @param self
+ * @param offset the string offset. SWTI_IMAGE_NONE is allowed.
+ * @return the string, or 0 for SWTI_IMAGE_NONE or an out of range offset.
+ */
+const char* swtiChunkImageString(const SwtiChunkImage* self, uint32_t offset)
+{
+    if (offset >= self->header->stringsSize) {
+        return 0;
+    }
+
+    return &self->strings[offset];
+}
+
+/***
+ * Finds a type with the same structural hash and type kind.
+ * @param self
+ * @param type the type to search for.
+ * @return the lowest type index with a matching hash, or -1 if not found.
+ */
+int swtiChunkImageFind(const SwtiChunkImage* self, const SwtiType* type)
+{
+    int foundIndex = -1;
+    SwtiHashIndexProbe probe;
+    swtiHashIndexProbeInit(&probe, &self->hashIndex, swtiTypeHash(type));
+    int i;
+    while ((i = swtiHashIndexProbeNext(&probe, &self->hashIndex, self->hashes)) >= 0) {
+        if ((size_t) i >= swtiChunkImageTypeCount(self)) {
+            break;
+        }
+        if (self->entries[i].type == type->type && (foundIndex < 0 || i < foundIndex)) {
+            foundIndex = i;
+        }
+    }
+
+    return foundIndex;
+}
+
+/***
+ * Finds a type given the name of the type. If several types have the same name, the first one is returned.
+ * @param self
+ * @param name the name to search for.
+ * @return the type index, or -1 if not found.
+ */
+int swtiChunkImageFindFromName(const SwtiChunkImage* self, const char* name)
+{
+    if (name == 0) {
+        return -1;
+    }
+
+    SwtiHashIndexProbe probe;
+    swtiHashIndexProbeInit(&probe, &self->nameIndex, swtiStringHash(name));
+    int i;
+    while ((i = swtiHashIndexProbeNext(&probe, &self->nameIndex, self->nameHashes)) >= 0) {
+        if ((size_t) i >= swtiChunkImageTypeCount(self)) {
+            break;
+        }
+        const char* typeName = swtiChunkImageString(self, self->entries[i].name);
+        if (typeName != 0 && tc_str_equal(typeName, name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/***
+ * Gets the index that is left when the alias chain is resolved, from the unaliased section of the image.
+ * @param self
+ * @param index the type index, can be an alias.
+ * @return the index of the first type in the chain that is not an alias. @p index if it is out of range or the
+ * stored index is.
+ */
+uint32_t swtiChunkImageUnaliasIndex(const SwtiChunkImage* self, size_t index)
+{
+    size_t typeCount = swtiChunkImageTypeCount(self);
+    if (index >= typeCount || self->unaliased[index] >= typeCount) {
+        return (uint32_t) index;
+    }
+
+    return self->unaliased[index];
+}
@@ -0,0 +1,136 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <swamp-typeinfo/intern.h>
+
+#define SWTI_STRING_TABLE_MIN_CAPACITY (32)
+
+/***
+ * Copies a string into memory from the allocator.
+ * @param allocator the allocator to copy into.
+ * @param str the string to copy, can be null.
+ * @return the copy, or null if @p str is null or if out of memory.
+ */
+const char* swtiStrDup(struct ImprintAllocator* allocator, const char* str)
+{
+    if (str == 0) {
+        return 0;
+    }
+
+    size_t octetCount = tc_strlen(str) + 1;
+    char* copy = IMPRINT_ALLOC_TYPE_COUNT(allocator, char, octetCount);
+    if (copy == 0) {
+        CLOG_SOFT_ERROR("swtiStrDup: out of memory")
+        return 0;
+    }
+    tc_memcpy_octets(copy, str, octetCount);
+
+    return copy;
+}
+
+/***
+ * Initializes an empty string table. No memory is allocated until the first string is interned.
+ * @param self
+ * @param allocator the allocator for the strings and the table.
+ */
+void swtiStringTableInit(SwtiStringTable* self, struct ImprintAllocator* allocator)
+{
+    self->strings = 0;
+    self->hashes = 0;
+    self->count = 0;
+    self->capacity = 0;
+    self->allocator = allocator;
+    swtiHashIndexInit(&self->index);
+}
+
+static const char* find(const SwtiStringTable* self, const char* str, uint32_t hash)
+{
+    SwtiHashIndexProbe probe;
+    swtiHashIndexProbeInit(&probe, &self->index, hash);
+    int i;
+    while ((i = swtiHashIndexProbeNext(&probe, &self->index, self->hashes)) >= 0) {
+        if (tc_str_equal(self->strings[i], str)) {
+            return self->strings[i];
+        }
+    }
+
+    return 0;
+}
+
+/// The previous arrays are abandoned, the allocator is expected to be a linear/arena allocator.
+static int grow(SwtiStringTable* self)
+{
+    size_t capacity = self->capacity == 0 ? SWTI_STRING_TABLE_MIN_CAPACITY : self->capacity * 2;
+    const char** strings = IMPRINT_ALLOC_TYPE_COUNT(self->allocator, const char*, capacity);
+    uint32_t* hashes = IMPRINT_ALLOC_TYPE_COUNT(self->allocator, uint32_t, capacity);
+    if (strings == 0 || hashes == 0) {
+        CLOG_SOFT_ERROR("swtiStringTableIntern: out of memory")
+        return -1;
+    }
+
+    if (self->count > 0) {
+        tc_memcpy_type(const char*, strings, self->strings, self->count);
+        tc_memcpy_type(uint32_t, hashes, self->hashes, self->count);
+    }
+    self->strings = strings;
+    self->hashes = hashes;
+    self->capacity = capacity;
+
+    return 0;
+}
+
+/***
+ * Finds a previously interned string.
+ * @param self
+ * @param str the string to search for, can be null.
+ * @return the interned string, or null if it has not been interned.
+ */
+const char* swtiStringTableFind(const SwtiStringTable* self, const char* str)
+{
+    if (str == 0) {
+        return 0;
+    }
+
+    return find(self, str, swtiStringHash(str));
+}
+
+/***
+ * Returns the interned copy of the string, copying it into the table the first time it is seen.
+ * @param self
+ * @param str the string to intern, can be null.
+ * @return the interned string, or null if @p str is null or if out of memory.
+ */
+const char* swtiStringTableIntern(SwtiStringTable* self, const char* str)
+{
+    if (str == 0) {
+        return 0;
+    }
+
+    uint32_t hash = swtiStringHash(str);
+    const char* existing = find(self, str, hash);
+    if (existing != 0) {
+        return existing;
+    }
+
+    if (self->count == self->capacity && grow(self) < 0) {
+        return 0;
+    }
+
+    const char* copy = swtiStrDup(self->allocator, str);
+    if (copy == 0) {
+        return 0;
+    }
+
+    size_t index = self->count;
+    self->strings[index] = copy;
+    self->hashes[index] = hash;
+    if (swtiHashIndexInsert(&self->index, self->hashes, (uint32_t) index, self->allocator) < 0) {
+        return 0;
+    }
+    self->count++;
+
+    return copy;
+}
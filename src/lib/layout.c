@@ -0,0 +1,123 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/image.h>
+#include <swamp-typeinfo/typeinfo.h>
+
+/// Aliases must be resolved before calling. @p own is the memory info stored in the type, if it has one.
+static int kindMemoryInfo(SwtiTypeValue kind, const SwtiMemoryInfo* own, SwtiMemoryInfo* out)
+{
+    switch (kind) {
+        case SwtiTypeRecord:
+        case SwtiTypeTuple:
+        case SwtiTypeCustom:
+        case SwtiTypeCustomVariant:
+            *out = *own;
+            return 0;
+        case SwtiTypeList:
+        case SwtiTypeArray:
+        case SwtiTypeBlob:
+        case SwtiTypeString:
+            out->memorySize = 8;
+            out->memoryAlign = 8;
+            return 0;
+        case SwtiTypeInt:
+        case SwtiTypeFixed:
+        case SwtiTypeChar:
+        case SwtiTypeRefId:
+            out->memorySize = 4;
+            out->memoryAlign = 4;
+            return 0;
+        case SwtiTypeBoolean:
+            out->memorySize = 1;
+            out->memoryAlign = 1;
+            return 0;
+        case SwtiTypeUnmanaged:
+            out->memorySize = 8;
+            out->memoryAlign = sizeof(void*);
+            return 0;
+        default:
+            out->memorySize = 0;
+            out->memoryAlign = 0;
+            return -1;
+    }
+}
+
+static const SwtiMemoryInfo* ownMemoryInfo(const SwtiType* type)
+{
+    switch (type->type) {
+        case SwtiTypeRecord:
+            return &((const SwtiRecordType*) type)->memoryInfo;
+        case SwtiTypeTuple:
+            return &((const SwtiTupleType*) type)->memoryInfo;
+        case SwtiTypeCustom:
+            return &((const SwtiCustomType*) type)->memoryInfo;
+        case SwtiTypeCustomVariant:
+            return &((const SwtiCustomTypeVariant*) type)->memoryInfo;
+        default:
+            return 0;
+    }
+}
+
+/***
+ * Gets the size and alignment that a value of the type occupies. Aliases are resolved.
+ * @param type the type to check.
+ * @param out receives the memory info, zero size and alignment on error.
+ * @return negative if the type has no known memory layout.
+ */
+int swtiGetMemoryInfo(const SwtiType* type, SwtiMemoryInfo* out)
+{
+    while (type->type == SwtiTypeAlias) {
+        type = ((const SwtiAliasType*) type)->targetType;
+        if ((uintptr_t) (const void*) type < 256) {
+            // Unresolved type reference, see swtiDebugOutput()
+            out->memorySize = 0;
+            out->memoryAlign = 0;
+            return -2;
+        }
+    }
+
+    return kindMemoryInfo(type->type, ownMemoryInfo(type), out);
+}
+
+/***
+ * Same as swtiGetMemoryInfo(), but reads the layout section of the image without materializing the type.
+ * @param self
+ * @param index the type index.
+ * @param out receives the memory info, zero size and alignment on error.
+ * @return negative if the type has no known memory layout.
+ */
+int swtiChunkImageMemoryInfo(const SwtiChunkImage* self, size_t index, SwtiMemoryInfo* out)
+{
+    if (index >= swtiChunkImageTypeCount(self)) {
+        out->memorySize = 0;
+        out->memoryAlign = 0;
+        return -1;
+    }
+
+    *out = self->layouts[index];
+
+    return out->memoryAlign == 0 ? -1 : 0;
+}
+
+/***
+ * Gets the precalculated size and alignment for a type in the chunk.
+ * Types without a known memory layout (e.g. functions) have zero size and alignment.
+ * @param self
+ * @param index the type index.
+ * @return the memory info, zero size and alignment if the index is not in the chunk.
+ */
+SwtiMemoryInfo swtiChunkMemoryInfo(const SwtiChunk* self, size_t index)
+{
+    if (index >= self->typeCount) {
+        SwtiMemoryInfo none;
+        none.memorySize = 0;
+        none.memoryAlign = 0;
+        return none;
+    }
+
+    return self->layouts[index];
+}
@@ -0,0 +1,380 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/custom.h>
+#include <swamp-typeinfo/image.h>
+#include <swamp-typeinfo/pointer_map.h>
+#include <swamp-typeinfo/record.h>
+#include <swamp-typeinfo/typeinfo.h>
+#include <swamp-typeinfo/value.h>
+
+#define SWTI_MATERIALIZE_MIN_PENDING (32)
+
+/***
+ * The types that are registered in the chunk, but whose references are not resolved yet. Most type graphs fit in
+ * the inline indices, larger ones are moved to the chunk allocator.
+ */
+typedef struct SwtiMaterializeContext {
+    const SwtiChunk* chunk;
+    uint32_t* pending;
+    size_t pendingCount;
+    size_t capacity;
+    int error;
+    uint32_t inlinePending[SWTI_MATERIALIZE_MIN_PENDING];
+} SwtiMaterializeContext;
+
+static SwtiType* allocateType(const SwtiChunk* self, const SwtiImageEntry* entry);
+
+static int pushPending(SwtiMaterializeContext* self, uint32_t index)
+{
+    if (self->pendingCount == self->capacity) {
+        size_t capacity = self->capacity * 2;
+        uint32_t* pending = IMPRINT_ALLOC_TYPE_COUNT(self->chunk->allocator, uint32_t, capacity);
+        if (pending == 0) {
+            CLOG_SOFT_ERROR("materialize: out of memory")
+            return -1;
+        }
+        tc_memcpy_type(uint32_t, pending, self->pending, self->pendingCount);
+        self->pending = pending;
+        self->capacity = capacity;
+    }
+    self->pending[self->pendingCount++] = index;
+
+    return 0;
+}
+
+/// Allocates and registers the type, its references are resolved later from the pending list.
+static const SwtiType* registerType(SwtiMaterializeContext* context, size_t index)
+{
+    const SwtiChunk* self = context->chunk;
+    const SwtiImageEntry* entry = swtiChunkImageEntry(self->image, index);
+    SwtiType* type = entry == 0 ? 0 : allocateType(self, entry);
+    if (type == 0 || pushPending(context, (uint32_t) index) < 0) {
+        context->error = -1;
+        return 0;
+    }
+
+    type->name = swtiChunkImageString(self->image, entry->name);
+    type->index = index;
+    self->types[index] = type;
+
+    return type;
+}
+
+static const SwtiType* resolve(SwtiMaterializeContext* context, uint32_t ref)
+{
+    const SwtiChunk* self = context->chunk;
+    if (ref == SWTI_IMAGE_NONE || ref >= self->typeCount) {
+        return 0;
+    }
+    if (self->types[ref] != 0) {
+        return self->types[ref];
+    }
+
+    return registerType(context, ref);
+}
+
+static SwtiMemoryInfo entryMemoryInfo(const SwtiImageEntry* entry)
+{
+    SwtiMemoryInfo info;
+    info.memorySize = entry->memorySize;
+    info.memoryAlign = entry->memoryAlign;
+
+    return info;
+}
+
+static SwtiMemoryOffsetInfo itemMemoryOffsetInfo(const SwtiImageItem* item)
+{
+    SwtiMemoryOffsetInfo info;
+    info.memoryOffset = item->memoryOffset;
+    info.memoryInfo.memorySize = item->memorySize;
+    info.memoryInfo.memoryAlign = item->memoryAlign;
+
+    return info;
+}
+
+static SwtiType* allocateType(const SwtiChunk* self, const SwtiImageEntry* entry)
+{
+    ImprintAllocator* allocator = self->allocator;
+
+    switch (entry->type) {
+        case SwtiTypeCustom: {
+            SwtiCustomType* custom = IMPRINT_ALLOC_TYPE(allocator, SwtiCustomType);
+            swtiInitCustom(custom, 0, 0, 0, allocator);
+            return &custom->internal;
+        }
+        case SwtiTypeFunction: {
+            SwtiFunctionType* fn = IMPRINT_ALLOC_TYPE(allocator, SwtiFunctionType);
+            swtiInitFunction(fn, 0, 0, allocator);
+            return &fn->internal;
+        }
+        case SwtiTypeAlias: {
+            SwtiAliasType* alias = IMPRINT_ALLOC_TYPE(allocator, SwtiAliasType);
+            swtiInitAlias(alias, 0, 0);
+            return &alias->internal;
+        }
+        case SwtiTypeRecord: {
+            SwtiRecordType* record = IMPRINT_ALLOC_TYPE(allocator, SwtiRecordType);
+            swtiInitRecord(record);
+            return &record->internal;
+        }
+        case SwtiTypeArray: {
+            SwtiArrayType* array = IMPRINT_ALLOC_TYPE(allocator, SwtiArrayType);
+            swtiInitArray(array);
+            return &array->internal;
+        }
+        case SwtiTypeList: {
+            SwtiListType* list = IMPRINT_ALLOC_TYPE(allocator, SwtiListType);
+            swtiInitList(list);
+            return &list->internal;
+        }
+        case SwtiTypeTuple: {
+            SwtiTupleType* tuple = IMPRINT_ALLOC_TYPE(allocator, SwtiTupleType);
+            swtiInitTuple(tuple, 0, 0, allocator);
+            return &tuple->internal;
+        }
+        case SwtiTypeRefId: {
+            SwtiTypeRefIdType* refId = IMPRINT_ALLOC_TYPE(allocator, SwtiTypeRefIdType);
+            swtiInitTypeRefId(refId, 0);
+            return &refId->internal;
+        }
+        case SwtiTypeUnmanaged: {
+            SwtiUnmanagedType* unmanaged = IMPRINT_ALLOC_TYPE(allocator, SwtiUnmanagedType);
+            swtiInitUnmanaged(unmanaged, (uint16_t) entry->target, 0, allocator);
+            return &unmanaged->internal;
+        }
+        case SwtiTypeString: {
+            SwtiStringType* str = IMPRINT_ALLOC_TYPE(allocator, SwtiStringType);
+            swtiInitString(str);
+            return &str->internal;
+        }
+        case SwtiTypeResourceName: {
+            SwtiResourceNameType* resourceName = IMPRINT_ALLOC_TYPE(allocator, SwtiResourceNameType);
+            swtiInitResourceName(resourceName);
+            return &resourceName->internal;
+        }
+        case SwtiTypeChar: {
+            SwtiCharType* charType = IMPRINT_ALLOC_TYPE(allocator, SwtiCharType);
+            swtiInitChar(charType);
+            return &charType->internal;
+        }
+        case SwtiTypeInt: {
+            SwtiIntType* intType = IMPRINT_ALLOC_TYPE(allocator, SwtiIntType);
+            swtiInitInt(intType);
+            return &intType->internal;
+        }
+        case SwtiTypeFixed: {
+            SwtiFixedType* fixedType = IMPRINT_ALLOC_TYPE(allocator, SwtiFixedType);
+            swtiInitFixed(fixedType);
+            return &fixedType->internal;
+        }
+        case SwtiTypeBoolean: {
+            SwtiBooleanType* booleanType = IMPRINT_ALLOC_TYPE(allocator, SwtiBooleanType);
+            swtiInitBoolean(booleanType);
+            return &booleanType->internal;
+        }
+        case SwtiTypeBlob: {
+            SwtiBlobType* blobType = IMPRINT_ALLOC_TYPE(allocator, SwtiBlobType);
+            swtiInitBlob(blobType);
+            return &blobType->internal;
+        }
+        case SwtiTypeAny: {
+            SwtiAnyType* any = IMPRINT_ALLOC_TYPE(allocator, SwtiAnyType);
+            swtiInitAny(any);
+            return &any->internal;
+        }
+        case SwtiTypeAnyMatchingTypes: {
+            SwtiAnyMatchingTypesType* anyMatchingTypes = IMPRINT_ALLOC_TYPE(allocator, SwtiAnyMatchingTypesType);
+            swtiInitAnyMatchingTypes(anyMatchingTypes);
+            return &anyMatchingTypes->internal;
+        }
+        default:
+            CLOG_SOFT_ERROR("materialize: unknown type %d", entry->type)
+            return 0;
+    }
+}
+
+static void resolveCustomType(SwtiMaterializeContext* context, SwtiCustomType* custom, const SwtiImageEntry* entry,
+                              const SwtiImageItem* items)
+{
+    const SwtiChunk* self = context->chunk;
+    const SwtiChunkImage* image = self->image;
+    ImprintAllocator* allocator = self->allocator;
+
+    size_t variantCount = items == 0 ? 0 : entry->itemCount;
+
+    custom->memoryInfo = entryMemoryInfo(entry);
+    custom->variantCount = variantCount;
+    custom->variantTypes = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiCustomTypeVariant*, variantCount);
+
+    for (size_t i = 0; i < variantCount; ++i) {
+        const SwtiImageItem* variantItem = &items[i];
+        SwtiCustomTypeVariant* variant = IMPRINT_ALLOC_TYPE(allocator, SwtiCustomTypeVariant);
+        swtiInitVariant(variant, 0, 0, allocator);
+        variant->name = swtiChunkImageString(image, variantItem->name);
+        variant->inCustomType = custom;
+        variant->memoryInfo.memorySize = variantItem->memorySize;
+        variant->memoryInfo.memoryAlign = variantItem->memoryAlign;
+        custom->variantTypes[i] = variant;
+
+        const SwtiImageItem* fieldItems = swtiChunkImageVariantFields(image, variantItem);
+        if (fieldItems == 0) {
+            continue;
+        }
+        SwtiCustomTypeVariantField* fields = IMPRINT_CALLOC_TYPE_COUNT(allocator, SwtiCustomTypeVariantField, variantItem->count);
+        variant->paramCount = (uint8_t) variantItem->count;
+        variant->fields = fields;
+        for (size_t j = 0; j < variantItem->count; ++j) {
+            fields[j].memoryOffsetInfo = itemMemoryOffsetInfo(&fieldItems[j]);
+            fields[j].fieldType = resolve(context, fieldItems[j].ref);
+        }
+    }
+}
+
+/// Sets everything that references other types. The type is already registered, so cycles resolve to it.
+static void resolveType(SwtiMaterializeContext* context, SwtiType* type, const SwtiImageEntry* entry)
+{
+    const SwtiChunk* self = context->chunk;
+    const SwtiChunkImage* image = self->image;
+    ImprintAllocator* allocator = self->allocator;
+    const SwtiImageItem* items = swtiChunkImageItems(image, entry);
+    size_t itemCount = items == 0 ? 0 : entry->itemCount;
+
+    switch (type->type) {
+        case SwtiTypeCustom:
+            resolveCustomType(context, (SwtiCustomType*) type, entry, items);
+            break;
+        case SwtiTypeFunction: {
+            SwtiFunctionType* fn = (SwtiFunctionType*) type;
+            const SwtiType** parameterTypes = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiType*, itemCount);
+            fn->parameterCount = itemCount;
+            fn->parameterTypes = parameterTypes;
+            for (size_t i = 0; i < itemCount; ++i) {
+                parameterTypes[i] = resolve(context, items[i].ref);
+            }
+        } break;
+        case SwtiTypeAlias:
+            ((SwtiAliasType*) type)->targetType = resolve(context, entry->target);
+            break;
+        case SwtiTypeRefId:
+            ((SwtiTypeRefIdType*) type)->referencedType = resolve(context, entry->target);
+            break;
+        case SwtiTypeRecord: {
+            SwtiRecordType* record = (SwtiRecordType*) type;
+            SwtiRecordTypeField* fields = IMPRINT_CALLOC_TYPE_COUNT(allocator, SwtiRecordTypeField, itemCount);
+            record->memoryInfo = entryMemoryInfo(entry);
+            record->fieldCount = itemCount;
+            record->fields = fields;
+            for (size_t i = 0; i < itemCount; ++i) {
+                fields[i].name = swtiChunkImageString(image, items[i].name);
+                fields[i].memoryOffsetInfo = itemMemoryOffsetInfo(&items[i]);
+                fields[i].fieldType = resolve(context, items[i].ref);
+            }
+        } break;
+        case SwtiTypeTuple: {
+            SwtiTupleType* tuple = (SwtiTupleType*) type;
+            SwtiTupleTypeField* fields = IMPRINT_CALLOC_TYPE_COUNT(allocator, SwtiTupleTypeField, itemCount);
+            tuple->memoryInfo = entryMemoryInfo(entry);
+            tuple->fieldCount = itemCount;
+            tuple->fields = fields;
+            for (size_t i = 0; i < itemCount; ++i) {
+                fields[i].name = swtiChunkImageString(image, items[i].name);
+                fields[i].memoryOffsetInfo = itemMemoryOffsetInfo(&items[i]);
+                fields[i].fieldType = resolve(context, items[i].ref);
+            }
+        } break;
+        case SwtiTypeArray: {
+            SwtiArrayType* array = (SwtiArrayType*) type;
+            array->memoryInfo = entryMemoryInfo(entry);
+            array->itemType = resolve(context, entry->target);
+        } break;
+        case SwtiTypeList: {
+            SwtiListType* list = (SwtiListType*) type;
+            list->memoryInfo = entryMemoryInfo(entry);
+            list->itemType = resolve(context, entry->target);
+        } break;
+        default:
+            break;
+    }
+}
+
+/***
+ * Decodes a type from the image that backs the chunk. All the types that it references, directly or through other
+ * types, and that are not decoded yet, are decoded as well, so the whole reachable type graph is materialized.
+ * The graph is walked with a work list instead of recursion, so long alias or record chains can not exhaust the stack.
+ * Names point directly into the image, so the image must outlive the chunk.
+ * @param self
+ * @param index the type index, must not be materialized yet.
+ * @return the materialized type, or 0 on error.
+ */
+const SwtiType* swtiChunkMaterialize(const SwtiChunk* self, size_t index)
+{
+    SwtiMaterializeContext context;
+    context.chunk = self;
+    context.pending = context.inlinePending;
+    context.pendingCount = 0;
+    context.capacity = SWTI_MATERIALIZE_MIN_PENDING;
+    context.error = 0;
+
+    const SwtiType* root = registerType(&context, index);
+    if (root == 0) {
+        return 0;
+    }
+
+    // A type is complete when its references are set, the referenced types only need to be registered
+    while (context.pendingCount > 0) {
+        uint32_t pendingIndex = context.pending[--context.pendingCount];
+        SwtiType* type = (SwtiType*) self->types[pendingIndex];
+        resolveType(&context, type, swtiChunkImageEntry(self->image, pendingIndex));
+        if (swtiChunkBuildTypeTables(self, pendingIndex) < 0) {
+            context.error = -1;
+        }
+    }
+
+    return context.error < 0 ? 0 : root;
+}
+
+/***
+ * Initializes a chunk that is backed by an image. No types are decoded until they are requested with
+ * swtiChunkTypeFromIndex(), and the hash and name indices are used directly from the image until more types
+ * are added to the chunk.
+ * @param self
+ * @param image the image, must outlive the chunk.
+ * @param allocator the allocator used for materialized types.
+ * @return negative on error.
+ */
+int swtiChunkInitFromImage(SwtiChunk* self, const SwtiChunkImage* image, struct ImprintAllocator* allocator)
+{
+    size_t typeCount = swtiChunkImageTypeCount(image);
+
+    if (swtiChunkInit(self, 0, 0, allocator) < 0) {
+        return -1;
+    }
+    self->image = image;
+    self->types = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiType*, typeCount);
+    self->fieldIndices = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiRecordFieldIndex*, typeCount);
+    self->variantTables = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiCustomVariantTable*, typeCount);
+    self->valuePlans = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiValuePlan*, typeCount);
+    self->copyPlans = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiValuePlan*, typeCount);
+    self->pointerMaps = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiPointerMap*, typeCount);
+    self->debugStrings = IMPRINT_CALLOC_TYPE_COUNT(allocator, const char*, typeCount);
+    if (self->types == 0 || self->fieldIndices == 0 || self->variantTables == 0 || self->valuePlans == 0 ||
+        self->copyPlans == 0 || self->pointerMaps == 0 || self->debugStrings == 0) {
+        return -1;
+    }
+    self->typeCount = typeCount;
+    self->maxCount = typeCount;
+    self->kinds = (uint8_t*) image->kinds;
+    self->layouts = (SwtiMemoryInfo*) image->layouts;
+    self->unaliased = (uint32_t*) image->unaliased;
+    self->hashes = (uint32_t*) image->hashes;
+    self->nameHashes = (uint32_t*) image->nameHashes;
+    self->hashIndex = image->hashIndex;
+    self->nameIndex = image->nameIndex;
+
+    return 0;
+}
@@ -0,0 +1,338 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <flood/in_stream.h>
+#include <flood/out_stream.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/pack.h>
+#include <swamp-typeinfo/value.h>
+#include <tiny-libc/tiny_libc.h>
+
+/// Items without padding or references are a single block that covers the whole stride, they are packed as is
+static int isDense(const SwtiValuePlan* plan, size_t stride)
+{
+    return plan->stepCount == 1 && plan->steps[0].kind == SwtiValueStepBlock && plan->steps[0].offset == 0 &&
+           plan->steps[0].size == stride;
+}
+
+/***
+ * Initializes a pack writer.
+ * @param self
+ * @param chunk the chunk with the types of the values.
+ * @param out the stream to write to.
+ * @param accessor gives access to the String, Blob, List and Array values.
+ * @param flush called when the stream is full. If it is null, everything must fit in the stream.
+ * @param flushUserData passed on to flush.
+ */
+void swtiPackWriterInit(SwtiPackWriter* self, const SwtiChunk* chunk, FldOutStream* out,
+                        const SwtiValueAccessor* accessor, SwtiPackFlush flush, void* flushUserData)
+{
+    self->chunk = chunk;
+    self->out = out;
+    self->accessor = accessor;
+    self->flush = flush;
+    self->flushUserData = flushUserData;
+}
+
+/***
+ * Hands the octets written to the stream so far to the flush callback and rewinds the stream.
+ * @param self
+ * @return negative on error.
+ */
+int swtiPackWriterFlush(SwtiPackWriter* self)
+{
+    if (self->flush == 0 || self->out->pos == 0) {
+        return 0;
+    }
+
+    int error = self->flush(self->flushUserData, self->out->octets, self->out->pos);
+    fldOutStreamRewind(self->out);
+
+    return error;
+}
+
+static int writeOctets(SwtiPackWriter* self, const uint8_t* octets, size_t count)
+{
+    FldOutStream* out = self->out;
+    if (out->pos + count <= out->size || self->flush == 0) {
+        return fldOutStreamWriteOctets(out, octets, count);
+    }
+
+    int error = swtiPackWriterFlush(self);
+    if (error < 0) {
+        return error;
+    }
+    if (count > out->size) {
+        return self->flush(self->flushUserData, octets, count);
+    }
+
+    return fldOutStreamWriteOctets(out, octets, count);
+}
+
+static int writeCount(SwtiPackWriter* self, size_t count)
+{
+    if (count > UINT32_MAX) {
+        CLOG_SOFT_ERROR("pack: count %zu is too large", count)
+        return -5;
+    }
+    uint32_t value = (uint32_t) count;
+
+    return writeOctets(self, (const uint8_t*) &value, sizeof(value));
+}
+
+static int writePlan(SwtiPackWriter* self, const SwtiValuePlan* plan, const uint8_t* value);
+
+static int writeItems(SwtiPackWriter* self, const SwtiValueStep* step, const uint8_t* slot)
+{
+    const void* items;
+    size_t itemCount;
+    int error;
+    if ((error = self->accessor->items(self->accessor->userData, slot, &items, &itemCount)) < 0) {
+        return error;
+    }
+    if ((error = writeCount(self, itemCount)) < 0 || itemCount == 0) {
+        return error;
+    }
+
+    const SwtiValuePlan* itemPlan = swtiChunkValuePlan(self->chunk, step->typeIndex);
+    if (itemPlan == 0) {
+        return -3;
+    }
+    size_t stride = swtiChunkValueStride(self->chunk, step->typeIndex);
+    if (isDense(itemPlan, stride)) {
+        return writeOctets(self, (const uint8_t*) items, stride * itemCount);
+    }
+
+    const uint8_t* item = (const uint8_t*) items;
+    for (size_t i = 0; i < itemCount; ++i) {
+        if ((error = writePlan(self, itemPlan, item)) < 0) {
+            return error;
+        }
+        item += stride;
+    }
+
+    return 0;
+}
+
+static int writePlan(SwtiPackWriter* self, const SwtiValuePlan* plan, const uint8_t* value)
+{
+    int error = 0;
+    for (size_t i = 0; i < plan->stepCount && error >= 0; ++i) {
+        const SwtiValueStep* step = &plan->steps[i];
+        const uint8_t* slot = value + step->offset;
+        switch (step->kind) {
+            case SwtiValueStepBlock:
+                error = writeOctets(self, slot, step->size);
+                break;
+            case SwtiValueStepString:
+            case SwtiValueStepBlob: {
+                const uint8_t* octets;
+                size_t octetCount;
+                if ((error = self->accessor->octets(self->accessor->userData, slot, &octets, &octetCount)) < 0 ||
+                    (error = writeCount(self, octetCount)) < 0) {
+                    break;
+                }
+                error = writeOctets(self, octets, octetCount);
+            } break;
+            case SwtiValueStepList:
+            case SwtiValueStepArray:
+                error = writeItems(self, step, slot);
+                break;
+            case SwtiValueStepCustom: {
+                // Only the tag and the fields of the variant are written, never the padding or the unused fields
+                uint8_t tag = *slot;
+                const SwtiValuePlan* customPlan = swtiChunkValuePlan(self->chunk, step->typeIndex);
+                if (customPlan == 0 || tag >= customPlan->variantCount) {
+                    CLOG_SOFT_ERROR("pack: illegal tag %d", tag)
+                    return -4;
+                }
+                if ((error = writeOctets(self, slot, sizeof(tag))) < 0) {
+                    break;
+                }
+                error = writePlan(self, customPlan->variantPlans[tag], slot);
+            } break;
+            default:
+                CLOG_SOFT_ERROR("pack: unmanaged values can not be packed")
+                return -6;
+        }
+    }
+
+    return error;
+}
+
+/***
+ * Packs a value.
+ * @param self
+ * @param typeIndex the type of the value.
+ * @param value the value to pack.
+ * @return negative on error.
+ */
+int swtiPackWriterWrite(SwtiPackWriter* self, size_t typeIndex, const void* value)
+{
+    const SwtiValuePlan* plan = swtiChunkValuePlan(self->chunk, typeIndex);
+    if (plan == 0) {
+        return -1;
+    }
+
+    return writePlan(self, plan, (const uint8_t*) value);
+}
+
+/***
+ * Initializes a pack reader.
+ * @param self
+ * @param chunk the chunk with the types of the values, must match the chunk the values were packed with.
+ * @param in the stream to read from.
+ * @param builder creates the String, Blob, List and Array values.
+ */
+void swtiPackReaderInit(SwtiPackReader* self, const SwtiChunk* chunk, FldInStream* in, const SwtiValueBuilder* builder)
+{
+    self->chunk = chunk;
+    self->in = in;
+    self->builder = builder;
+}
+
+static int readCount(SwtiPackReader* self, size_t* count)
+{
+    uint32_t value;
+    int error = fldInStreamReadOctets(self->in, (uint8_t*) &value, sizeof(value));
+    *count = value;
+
+    return error;
+}
+
+static int readPlan(SwtiPackReader* self, const SwtiValuePlan* plan, uint8_t* value);
+
+static int readOctetsReference(SwtiPackReader* self, const SwtiValueStep* step, uint8_t* slot)
+{
+    size_t octetCount;
+    int error;
+    if ((error = readCount(self, &octetCount)) < 0) {
+        return error;
+    }
+
+    FldInStream* in = self->in;
+    if (octetCount > in->size - in->pos) {
+        CLOG_SOFT_ERROR("unpack: octet count %zu is outside the stream", octetCount)
+        return -2;
+    }
+
+    // The octets are handed over straight from the stream, the builder decides if they need to be copied
+    if ((error = self->builder->octets(self->builder->userData, step, slot, in->p, octetCount)) < 0) {
+        return error;
+    }
+    in->p += octetCount;
+    in->pos += octetCount;
+
+    return 0;
+}
+
+static int readItems(SwtiPackReader* self, const SwtiValueStep* step, uint8_t* slot)
+{
+    size_t itemCount;
+    int error;
+    if ((error = readCount(self, &itemCount)) < 0) {
+        return error;
+    }
+
+    const SwtiValuePlan* itemPlan = swtiChunkValuePlan(self->chunk, step->typeIndex);
+    if (itemPlan == 0) {
+        return -3;
+    }
+    size_t stride = swtiChunkValueStride(self->chunk, step->typeIndex);
+    int dense = isDense(itemPlan, stride);
+
+    // Every packed item takes at least one octet, so a count that can not fit in the rest of the stream is rejected
+    // before the builder allocates anything for it
+    size_t itemOctetCount = dense ? stride : 1;
+    if (itemCount > (self->in->size - self->in->pos) / itemOctetCount) {
+        CLOG_SOFT_ERROR("unpack: item count %zu is outside the stream", itemCount)
+        return -2;
+    }
+
+    void* items = 0;
+    if ((error = self->builder->items(self->builder->userData, step, slot, itemCount, &items)) < 0) {
+        return error;
+    }
+    if (itemCount == 0) {
+        return 0;
+    }
+    if (dense) {
+        return fldInStreamReadOctets(self->in, (uint8_t*) items, stride * itemCount);
+    }
+
+    // The padding is not packed, it is cleared
+    tc_mem_clear((uint8_t*) items, stride * itemCount);
+    uint8_t* item = (uint8_t*) items;
+    for (size_t i = 0; i < itemCount; ++i) {
+        if ((error = readPlan(self, itemPlan, item)) < 0) {
+            return error;
+        }
+        item += stride;
+    }
+
+    return 0;
+}
+
+static int readPlan(SwtiPackReader* self, const SwtiValuePlan* plan, uint8_t* value)
+{
+    int error = 0;
+    for (size_t i = 0; i < plan->stepCount && error >= 0; ++i) {
+        const SwtiValueStep* step = &plan->steps[i];
+        uint8_t* slot = value + step->offset;
+        switch (step->kind) {
+            case SwtiValueStepBlock:
+                error = fldInStreamReadOctets(self->in, slot, step->size);
+                break;
+            case SwtiValueStepString:
+            case SwtiValueStepBlob:
+                error = readOctetsReference(self, step, slot);
+                break;
+            case SwtiValueStepList:
+            case SwtiValueStepArray:
+                error = readItems(self, step, slot);
+                break;
+            case SwtiValueStepCustom: {
+                uint8_t tag;
+                if ((error = fldInStreamReadOctets(self->in, &tag, sizeof(tag))) < 0) {
+                    break;
+                }
+                const SwtiValuePlan* customPlan = swtiChunkValuePlan(self->chunk, step->typeIndex);
+                if (customPlan == 0 || tag >= customPlan->variantCount) {
+                    CLOG_SOFT_ERROR("unpack: illegal tag %d", tag)
+                    return -4;
+                }
+                // The padding and the fields that the variant does not use are cleared
+                tc_mem_clear(slot, step->size);
+                *slot = tag;
+                error = readPlan(self, customPlan->variantPlans[tag], slot);
+            } break;
+            default:
+                CLOG_SOFT_ERROR("unpack: unmanaged values can not be unpacked")
+                return -6;
+        }
+    }
+
+    return error;
+}
+
+/***
+ * Unpacks a value that was packed with swtiPackWriterWrite().
+ * @param self
+ * @param typeIndex the type of the value.
+ * @param value where to unpack the value to.
+ * @return negative on error.
+ */
+int swtiPackReaderRead(SwtiPackReader* self, size_t typeIndex, void* value)
+{
+    const SwtiValuePlan* plan = swtiChunkValuePlan(self->chunk, typeIndex);
+    if (plan == 0) {
+        return -1;
+    }
+
+    // The padding is not packed, it is cleared
+    tc_mem_clear((uint8_t*) value, plan->memoryInfo.memorySize);
+
+    return readPlan(self, plan, (uint8_t*) value);
+}
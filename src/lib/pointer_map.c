@@ -0,0 +1,174 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/pointer_map.h>
+#include <swamp-typeinfo/value.h>
+
+static int isManagedReference(uint8_t kind)
+{
+    switch (kind) {
+        case SwtiValueStepString:
+        case SwtiValueStepBlob:
+        case SwtiValueStepList:
+        case SwtiValueStepArray:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/// The map is derived from the copy plan, which already has the references flattened and sorted by offset.
+static SwtiPointerMap* compileSteps(const SwtiChunk* chunk, const SwtiValuePlan* copyPlan)
+{
+    size_t offsetCount = 0;
+    size_t customCount = 0;
+    for (size_t i = 0; i < copyPlan->stepCount; ++i) {
+        uint8_t kind = copyPlan->steps[i].kind;
+        offsetCount += isManagedReference(kind);
+        customCount += kind == SwtiValueStepCustom;
+    }
+
+    ImprintAllocator* allocator = chunk->allocator;
+    SwtiPointerMap* map = IMPRINT_ALLOC_TYPE(allocator, SwtiPointerMap);
+    SwtiMemoryOffset* offsets = IMPRINT_ALLOC_TYPE_COUNT(allocator, SwtiMemoryOffset, offsetCount);
+    SwtiPointerMapCustom* customs = IMPRINT_ALLOC_TYPE_COUNT(allocator, SwtiPointerMapCustom, customCount);
+    if (map == 0 || (offsets == 0 && offsetCount > 0) || (customs == 0 && customCount > 0)) {
+        CLOG_SOFT_ERROR("pointer map: out of memory")
+        return 0;
+    }
+
+    size_t offsetIndex = 0;
+    size_t customIndex = 0;
+    for (size_t i = 0; i < copyPlan->stepCount; ++i) {
+        const SwtiValueStep* step = &copyPlan->steps[i];
+        if (isManagedReference(step->kind)) {
+            offsets[offsetIndex++] = step->offset;
+        } else if (step->kind == SwtiValueStepCustom) {
+            customs[customIndex].offset = step->offset;
+            customs[customIndex].typeIndex = step->typeIndex;
+            customIndex++;
+        }
+    }
+
+    map->offsets = offsets;
+    map->offsetCount = offsetCount;
+    map->customs = customs;
+    map->customCount = customCount;
+    map->variantMaps = 0;
+    map->variantCount = 0;
+
+    return map;
+}
+
+/// Cached for types that could not get a pointer map, so they are not compiled (and logged) again on each request
+static const SwtiPointerMap noMap;
+
+static SwtiPointerMap* compileMap(const SwtiChunk* chunk, const SwtiValuePlan* copyPlan)
+{
+    SwtiPointerMap* map = compileSteps(chunk, copyPlan);
+    if (map == 0 || copyPlan->variantCount == 0) {
+        return map;
+    }
+
+    // Custom steps in the copy plan of a custom type refer to the type itself, the variants are in the variant maps
+    map->customCount = 0;
+
+    const SwtiPointerMap** variantMaps = IMPRINT_ALLOC_TYPE_COUNT(chunk->allocator, const SwtiPointerMap*,
+                                                                   copyPlan->variantCount);
+    if (variantMaps == 0) {
+        CLOG_SOFT_ERROR("pointer map: out of memory")
+        return 0;
+    }
+    for (size_t i = 0; i < copyPlan->variantCount; ++i) {
+        variantMaps[i] = compileSteps(chunk, copyPlan->variantPlans[i]);
+        if (variantMaps[i] == 0) {
+            return 0;
+        }
+    }
+
+    map->variantMaps = variantMaps;
+    map->variantCount = copyPlan->variantCount;
+
+    return map;
+}
+
+/***
+ * Gets the pointer map for a type. It is compiled the first time it is requested and then cached in the chunk, like
+ * the plans in swtiChunkValuePlan().
+ * @param self
+ * @param typeIndex the type index, aliases are resolved.
+ * @return the pointer map, or null if the type has no value layout (e.g. functions) or is not in the chunk.
+ */
+const SwtiPointerMap* swtiChunkPointerMap(const SwtiChunk* self, size_t typeIndex)
+{
+    size_t index = swtiChunkUnaliasIndex(self, typeIndex);
+    if (index >= self->typeCount) {
+        return 0;
+    }
+    const SwtiPointerMap* map = self->pointerMaps[index];
+    if (map == 0 && !self->frozen) {
+        const SwtiValuePlan* copyPlan = swtiChunkCopyPlan(self, index);
+        map = copyPlan != 0 ? compileMap(self, copyPlan) : 0;
+        self->pointerMaps[index] = map != 0 ? map : &noMap;
+    }
+
+    return map == &noMap ? 0 : map;
+}
+
+static int scanMap(const SwtiChunk* chunk, const SwtiPointerMap* map, uint8_t* value, SwtiPointerMapVisit visit,
+                   void* userData)
+{
+    for (size_t i = 0; i < map->offsetCount; ++i) {
+        visit(userData, value + map->offsets[i]);
+    }
+
+    for (size_t i = 0; i < map->customCount; ++i) {
+        const SwtiPointerMapCustom* custom = &map->customs[i];
+        uint8_t* customValue = value + custom->offset;
+        const SwtiPointerMap* customMap = swtiChunkPointerMap(chunk, custom->typeIndex);
+        uint8_t tag = *customValue;
+        if (customMap == 0 || tag >= customMap->variantCount) {
+            CLOG_SOFT_ERROR("pointer map: illegal tag %d", tag)
+            return -4;
+        }
+        int error = scanMap(chunk, customMap->variantMaps[tag], customValue, visit, userData);
+        if (error < 0) {
+            return error;
+        }
+    }
+
+    return 0;
+}
+
+/***
+ * Calls visit for every slot in the value that holds a managed reference.
+ * @param self
+ * @param typeIndex the type of the value.
+ * @param value the value to scan.
+ * @param visit called with the address of each reference slot.
+ * @param userData passed on to visit.
+ * @return negative on error.
+ */
+int swtiChunkScanReferences(const SwtiChunk* self, size_t typeIndex, void* value, SwtiPointerMapVisit visit,
+                            void* userData)
+{
+    const SwtiPointerMap* map = swtiChunkPointerMap(self, typeIndex);
+    if (map == 0) {
+        return -1;
+    }
+
+    if (map->variantCount > 0) {
+        uint8_t tag = *(const uint8_t*) value;
+        if (tag >= map->variantCount) {
+            CLOG_SOFT_ERROR("pointer map: illegal tag %d", tag)
+            return -4;
+        }
+        map = map->variantMaps[tag];
+    }
+
+    return scanMap(self, map, (uint8_t*) value, visit, userData);
+}
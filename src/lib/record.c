@@ -0,0 +1,96 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/record.h>
+#include <swamp-typeinfo/typeinfo.h>
+
+/***
+ * Builds the field name index for a record. The record fields must not change after this.
+ * @param self
+ * @param record the record to index.
+ * @param allocator the allocator for the index.
+ * @return negative on error.
+ */
+int swtiRecordFieldIndexInit(SwtiRecordFieldIndex* self, const SwtiRecordType* record, struct ImprintAllocator* allocator)
+{
+    swtiHashIndexInit(&self->index);
+    self->nameHashes = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint32_t, record->fieldCount);
+    if (self->nameHashes == 0 && record->fieldCount > 0) {
+        CLOG_SOFT_ERROR("swtiRecordFieldIndexInit: out of memory")
+        return -1;
+    }
+
+    int error;
+    for (size_t i = 0; i < record->fieldCount; ++i) {
+        self->nameHashes[i] = swtiStringHash(record->fields[i].name);
+        if ((error = swtiHashIndexInsert(&self->index, self->nameHashes, (uint32_t) i, allocator)) < 0) {
+            return error;
+        }
+    }
+
+    return 0;
+}
+
+/***
+ * Finds a field from its name.
+ * @param self
+ * @param record the record that was indexed.
+ * @param name the field name.
+ * @return the field index, or -1 if not found.
+ */
+int swtiRecordFieldIndexFind(const SwtiRecordFieldIndex* self, const SwtiRecordType* record, const char* name)
+{
+    SwtiHashIndexProbe probe;
+    swtiHashIndexProbeInit(&probe, &self->index, swtiStringHash(name));
+    int i;
+    while ((i = swtiHashIndexProbeNext(&probe, &self->index, self->nameHashes)) >= 0) {
+        const char* fieldName = record->fields[i].name;
+        if (fieldName == name || (fieldName != 0 && tc_str_equal(fieldName, name))) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/***
+ * Finds a field in a record that is in the chunk. Aliases to records are resolved.
+ * @param self
+ * @param recordIndex the type index of the record.
+ * @param name the field name.
+ * @param out receives the offset and memory info for the field, can be null.
+ * @return the field index, or negative if not found. A type that is not a record is counted as a kind mismatch in
+ * the chunk diagnostics.
+ */
+int swtiChunkFindRecordField(const SwtiChunk* self, size_t recordIndex, const char* name, SwtiMemoryOffsetInfo* out)
+{
+    if (name == 0) {
+        return -1;
+    }
+
+    size_t index = swtiChunkUnaliasIndex(self, recordIndex);
+    if (index >= self->typeCount) {
+        return -1;
+    }
+    if (self->kinds[index] != SwtiTypeRecord) {
+        swtiChunkDiagnosticsReport(self, SwtiChunkDiagnosticKindMismatch, (int) recordIndex, name);
+        return -2;
+    }
+
+    const SwtiRecordType* record = (const SwtiRecordType*) swtiChunkTypeFromIndex(self, index);
+    const SwtiRecordFieldIndex* fieldIndex = self->fieldIndices[index];
+    if (record == 0 || fieldIndex == 0) {
+        return -3;
+    }
+
+    int found = swtiRecordFieldIndexFind(fieldIndex, record, name);
+    if (found >= 0 && out != 0) {
+        *out = record->fields[found].memoryOffsetInfo;
+    }
+
+    return found;
+}
@@ -0,0 +1,69 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/stats.h>
+
+static void* countingAlloc(void* self, size_t size, const char* sourceFile, size_t line, const char* description)
+{
+    SwtiCountingAllocator* counting = (SwtiCountingAllocator*) self;
+    counting->stats->allocationCount++;
+    counting->stats->allocatedOctetCount += size;
+
+    return counting->parent->allocDebugFn(counting->parent, size, sourceFile, line, description);
+}
+
+static void* countingCalloc(void* self, size_t size, const char* sourceFile, size_t line, const char* description)
+{
+    SwtiCountingAllocator* counting = (SwtiCountingAllocator*) self;
+    counting->stats->allocationCount++;
+    counting->stats->allocatedOctetCount += size;
+
+    return counting->parent->callocDebugFn(counting->parent, size, sourceFile, line, description);
+}
+
+/***
+ * Initializes an allocator that counts the allocations in @p stats and forwards them to @p parent.
+ * @param self
+ * @param parent the allocator that does the actual allocations.
+ * @param stats where to count the allocations.
+ */
+void swtiCountingAllocatorInit(SwtiCountingAllocator* self, ImprintAllocator* parent, SwtiChunkStats* stats)
+{
+    self->info.allocDebugFn = countingAlloc;
+    self->info.callocDebugFn = countingCalloc;
+    self->parent = parent;
+    self->stats = stats;
+}
+
+/***
+ * Gets the counters for the chunk. All counters are zero if the library is built without SWTI_CHUNK_STATS.
+ * @param self
+ * @param out receives the counters.
+ */
+void swtiChunkStats(const SwtiChunk* self, SwtiChunkStats* out)
+{
+#if SWTI_CHUNK_STATS
+    if (self->stats != 0) {
+        *out = *self->stats;
+        return;
+    }
+#endif
+    tc_mem_clear_type(out);
+}
+
+/***
+ * Sets all the counters for the chunk to zero.
+ * @param self
+ */
+void swtiChunkStatsReset(SwtiChunk* self)
+{
+#if SWTI_CHUNK_STATS
+    if (self->stats != 0) {
+        tc_mem_clear_type(self->stats);
+    }
+#endif
+}
@@ -4,6 +4,8 @@
  *--------------------------------------------------------------------------------------------*/
 #include <imprint/allocator.h>
 #include <memory.h>
+#include <swamp-typeinfo/hash.h>
+#include <swamp-typeinfo/intern.h>
 #include <swamp-typeinfo/typeinfo.h>
 #include <tiny-libc/tiny_libc.h>
 
@@ -11,21 +13,21 @@ void swtiInitString(SwtiStringType* self)
 {
     self->internal.type = SwtiTypeString;
     self->internal.name = "String";
-    self->internal.hash = 0x0000;
+    self->internal.hash = swtiTypeHashFold(swtiTypeHash(&self->internal));
 }
 
 void swtiInitResourceName(SwtiResourceNameType* self)
 {
     self->internal.type = SwtiTypeResourceName;
     self->internal.name = "ResourceName";
-    self->internal.hash = 0x0000;
+    self->internal.hash = swtiTypeHashFold(swtiTypeHash(&self->internal));
 }
 
 void swtiInitChar(SwtiCharType* self)
 {
     self->internal.type = SwtiTypeChar;
     self->internal.name = "Char";
-    self->internal.hash = 0x0000;
+    self->internal.hash = swtiTypeHashFold(swtiTypeHash(&self->internal));
 }
 
 
@@ -41,14 +43,14 @@ void swtiInitInt(SwtiIntType* self)
 {
     self->internal.type = SwtiTypeInt;
     self->internal.name = "Int";
-    self->internal.hash = 0x0000;
+    self->internal.hash = swtiTypeHashFold(swtiTypeHash(&self->internal));
 }
 
 void swtiInitAny(SwtiAnyType* self)
 {
     self->internal.type = SwtiTypeAny;
     self->internal.name = "Any";
-    self->internal.hash = 0x0000;
+    self->internal.hash = swtiTypeHashFold(swtiTypeHash(&self->internal));
 }
 
 void swtiInitUnmanaged(SwtiUnmanagedType* self, uint16_t userTypeId, const char* name, ImprintAllocator* allocator)
@@ -59,36 +61,37 @@ void swtiInitUnmanaged(SwtiUnmanagedType* self, uint16_t userTypeId, const char*
     } else {
         self->internal.name = 0;
     }
-    self->internal.hash = 0x0000;
     self->userTypeId = userTypeId;
+    // The name is part of the hash and is often assigned after initialization, so wait for the chunk to hash it
+    self->internal.hash = 0x0000;
 }
 
 void swtiInitAnyMatchingTypes(SwtiAnyMatchingTypesType * self)
 {
     self->internal.type = SwtiTypeAnyMatchingTypes;
     self->internal.name = "*";
-    self->internal.hash = 0x0000;
+    self->internal.hash = swtiTypeHashFold(swtiTypeHash(&self->internal));
 }
 
 void swtiInitFixed(SwtiFixedType* self)
 {
     self->internal.type = SwtiTypeFixed;
     self->internal.name = "Fixed";
-    self->internal.hash = 0x0000;
+    self->internal.hash = swtiTypeHashFold(swtiTypeHash(&self->internal));
 }
 
 void swtiInitBoolean(SwtiBooleanType* self)
 {
     self->internal.type = SwtiTypeBoolean;
     self->internal.name = "Bool";
-    self->internal.hash = 0x0000;
+    self->internal.hash = swtiTypeHashFold(swtiTypeHash(&self->internal));
 }
 
 void swtiInitBlob(SwtiBlobType* self)
 {
     self->internal.type = SwtiTypeBlob;
     self->internal.name = "Blob";
-    self->internal.hash = 0x0000;
+    self->internal.hash = swtiTypeHashFold(swtiTypeHash(&self->internal));
 }
 
 void swtiInitArray(SwtiArrayType* self)
@@ -103,7 +106,7 @@ void swtiInitList(SwtiListType* self)
     self->internal.type = SwtiTypeList;
     self->internal.name = "List";
     self->internal.hash = 0x0000;
-    self->internal.index = 0xffff;
+    self->internal.index = 0xffffffff;
 }
 
 void swtiInitFunction(SwtiFunctionType* self, const SwtiType** types, size_t typeCount, ImprintAllocator* allocator)
@@ -172,7 +175,7 @@ void swtiInitTuple(SwtiTupleType* self, const SwtiTupleTypeField sourceFields[],
     self->fields = IMPRINT_CALLOC_TYPE_COUNT(allocator, SwtiTupleTypeField, typeCount);
     for (size_t i=0; i<self->fieldCount; ++i) {
         ((SwtiTupleTypeField *)&self->fields[i])->memoryOffsetInfo = sourceFields[i].memoryOffsetInfo;
-        *(char **)&self->fields[i].name = tc_str_dup(sourceFields[i].name);
+        ((SwtiTupleTypeField *)&self->fields[i])->name = swtiStrDup(allocator, sourceFields[i].name);
     }
 }
 
@@ -186,7 +189,6 @@ void swtiInitVariant(SwtiCustomTypeVariant* self, const SwtiCustomTypeVariantFie
     self->fields = IMPRINT_CALLOC_TYPE_COUNT(allocator, SwtiCustomTypeVariantField, typeCount);
     for (size_t i=0; i<self->paramCount; ++i) {
         ((SwtiCustomTypeVariantField *)&self->fields[i])->memoryOffsetInfo = sourceFields[i].memoryOffsetInfo;
-        //*(char **)&self->fields[i].name = tc_str_dup(sourceFields[i].name);
     }
 }
 
@@ -217,7 +219,9 @@ void swtiInitCustom(SwtiCustomType* self, const char* name, const SwtiCustomType
     self->variantTypes = IMPRINT_CALLOC_TYPE_COUNT(allocator, const SwtiCustomTypeVariant*, variantCount);
     self->generic.genericTypes = 0;
     self->generic.genericCount = 0;
-    tc_memcpy_type_n(self->variantTypes, variants, variantCount);
+    for (size_t i = 0; i < variantCount; ++i) {
+        self->variantTypes[i] = &variants[i];
+    }
 }
 
 static void initGenerics(SwtiGenericParams* self, const SwtiType* types[], size_t typeCount, ImprintAllocator* allocator)
@@ -0,0 +1,248 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/value.h>
+
+#define SWTI_VALUE_HASH_SEED (0x811c9dc5u)
+
+static int planEqual(const SwtiChunk* chunk, const SwtiValuePlan* plan, const uint8_t* a, const uint8_t* b,
+                     const SwtiValueAccessor* accessor);
+
+static int octetsEqual(const SwtiValueStep* step, const uint8_t* a, const uint8_t* b, const SwtiValueAccessor* accessor)
+{
+    const uint8_t* octetsA;
+    const uint8_t* octetsB;
+    size_t countA;
+    size_t countB;
+    if (accessor->octets(accessor->userData, a + step->offset, &octetsA, &countA) < 0 ||
+        accessor->octets(accessor->userData, b + step->offset, &octetsB, &countB) < 0) {
+        return -2;
+    }
+
+    if (countA != countB) {
+        return 0;
+    }
+
+    return octetsA == octetsB || countA == 0 || tc_memcmp(octetsA, octetsB, countA) == 0;
+}
+
+static int itemsEqual(const SwtiChunk* chunk, const SwtiValueStep* step, const uint8_t* a, const uint8_t* b,
+                      const SwtiValueAccessor* accessor)
+{
+    const void* itemsA;
+    const void* itemsB;
+    size_t countA;
+    size_t countB;
+    if (accessor->items(accessor->userData, a + step->offset, &itemsA, &countA) < 0 ||
+        accessor->items(accessor->userData, b + step->offset, &itemsB, &countB) < 0) {
+        return -2;
+    }
+
+    if (countA != countB) {
+        return 0;
+    }
+    if (itemsA == itemsB || countA == 0) {
+        return 1;
+    }
+
+    const SwtiValuePlan* itemPlan = swtiChunkValuePlan(chunk, step->typeIndex);
+    if (itemPlan == 0) {
+        return -3;
+    }
+    size_t stride = swtiChunkValueStride(chunk, step->typeIndex);
+
+    const uint8_t* itemA = (const uint8_t*) itemsA;
+    const uint8_t* itemB = (const uint8_t*) itemsB;
+    for (size_t i = 0; i < countA; ++i) {
+        int result = planEqual(chunk, itemPlan, itemA, itemB, accessor);
+        if (result <= 0) {
+            return result;
+        }
+        itemA += stride;
+        itemB += stride;
+    }
+
+    return 1;
+}
+
+static int customEqual(const SwtiChunk* chunk, const SwtiValueStep* step, const uint8_t* a, const uint8_t* b,
+                       const SwtiValueAccessor* accessor)
+{
+    const uint8_t* customA = a + step->offset;
+    const uint8_t* customB = b + step->offset;
+    uint8_t tag = *customA;
+    if (tag != *customB) {
+        return 0;
+    }
+
+    const SwtiValuePlan* customPlan = swtiChunkValuePlan(chunk, step->typeIndex);
+    if (customPlan == 0 || tag >= customPlan->variantCount) {
+        CLOG_SOFT_ERROR("value equal: illegal tag %d", tag)
+        return -4;
+    }
+
+    return planEqual(chunk, customPlan->variantPlans[tag], customA, customB, accessor);
+}
+
+/// @return 1 if equal, 0 if not equal and negative on error.
+static int planEqual(const SwtiChunk* chunk, const SwtiValuePlan* plan, const uint8_t* a, const uint8_t* b,
+                     const SwtiValueAccessor* accessor)
+{
+    int result = 1;
+    for (size_t i = 0; i < plan->stepCount && result == 1; ++i) {
+        const SwtiValueStep* step = &plan->steps[i];
+        switch (step->kind) {
+            case SwtiValueStepBlock:
+            case SwtiValueStepUnmanaged:
+                result = tc_memcmp(a + step->offset, b + step->offset, step->size) == 0;
+                break;
+            case SwtiValueStepString:
+            case SwtiValueStepBlob:
+                result = octetsEqual(step, a, b, accessor);
+                break;
+            case SwtiValueStepList:
+            case SwtiValueStepArray:
+                result = itemsEqual(chunk, step, a, b, accessor);
+                break;
+            case SwtiValueStepCustom:
+                result = customEqual(chunk, step, a, b, accessor);
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    return result;
+}
+
+/***
+ * Compares two values of the same type. Plain data is compared with memcmp, only Strings, Blobs, Lists and Arrays
+ * are followed through the accessor.
+ * @param self
+ * @param typeIndex the type of both values.
+ * @param a the first value.
+ * @param b the second value.
+ * @param accessor gives access to the contents of Strings, Blobs, Lists and Arrays.
+ * @return 1 if equal, 0 if not equal and negative on error.
+ */
+int swtiChunkValueEqual(const SwtiChunk* self, size_t typeIndex, const void* a, const void* b,
+                        const SwtiValueAccessor* accessor)
+{
+    const SwtiValuePlan* plan = swtiChunkValuePlan(self, typeIndex);
+    if (plan == 0) {
+        return -1;
+    }
+
+    if (a == b) {
+        return 1;
+    }
+
+    return planEqual(self, plan, (const uint8_t*) a, (const uint8_t*) b, accessor);
+}
+
+static uint32_t hashOctets(uint32_t hash, const uint8_t* octets, size_t octetCount)
+{
+    for (size_t i = 0; i < octetCount; ++i) {
+        hash ^= octets[i];
+        hash *= 0x01000193u;
+    }
+
+    return hash;
+}
+
+static uint32_t hashCount(uint32_t hash, size_t count)
+{
+    uint32_t value = (uint32_t) count;
+
+    return hashOctets(hash, (const uint8_t*) &value, sizeof(value));
+}
+
+static int planHash(const SwtiChunk* chunk, const SwtiValuePlan* plan, const uint8_t* value,
+                    const SwtiValueAccessor* accessor, uint32_t* hash)
+{
+    int error;
+    for (size_t i = 0; i < plan->stepCount; ++i) {
+        const SwtiValueStep* step = &plan->steps[i];
+        const uint8_t* slot = value + step->offset;
+        switch (step->kind) {
+            case SwtiValueStepBlock:
+            case SwtiValueStepUnmanaged:
+                *hash = hashOctets(*hash, slot, step->size);
+                break;
+            case SwtiValueStepString:
+            case SwtiValueStepBlob: {
+                const uint8_t* octets;
+                size_t octetCount;
+                if ((error = accessor->octets(accessor->userData, slot, &octets, &octetCount)) < 0) {
+                    return error;
+                }
+                *hash = hashOctets(hashCount(*hash, octetCount), octets, octetCount);
+            } break;
+            case SwtiValueStepList:
+            case SwtiValueStepArray: {
+                const void* items;
+                size_t itemCount;
+                if ((error = accessor->items(accessor->userData, slot, &items, &itemCount)) < 0) {
+                    return error;
+                }
+                *hash = hashCount(*hash, itemCount);
+                if (itemCount == 0) {
+                    break;
+                }
+                const SwtiValuePlan* itemPlan = swtiChunkValuePlan(chunk, step->typeIndex);
+                if (itemPlan == 0) {
+                    return -3;
+                }
+                size_t stride = swtiChunkValueStride(chunk, step->typeIndex);
+                const uint8_t* item = (const uint8_t*) items;
+                for (size_t itemIndex = 0; itemIndex < itemCount; ++itemIndex) {
+                    if ((error = planHash(chunk, itemPlan, item, accessor, hash)) < 0) {
+                        return error;
+                    }
+                    item += stride;
+                }
+            } break;
+            case SwtiValueStepCustom: {
+                uint8_t tag = *slot;
+                const SwtiValuePlan* customPlan = swtiChunkValuePlan(chunk, step->typeIndex);
+                if (customPlan == 0 || tag >= customPlan->variantCount) {
+                    CLOG_SOFT_ERROR("value hash: illegal tag %d", tag)
+                    return -4;
+                }
+                *hash = hashOctets(*hash, &tag, 1);
+                if ((error = planHash(chunk, customPlan->variantPlans[tag], slot, accessor, hash)) < 0) {
+                    return error;
+                }
+            } break;
+            default:
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+/***
+ * Calculates a hash for a value. Values that are equal according to swtiChunkValueEqual() get the same hash.
+ * @param self
+ * @param typeIndex the type of the value.
+ * @param value the value to hash.
+ * @param accessor gives access to the contents of Strings, Blobs, Lists and Arrays.
+ * @param outHash receives the hash.
+ * @return negative on error.
+ */
+int swtiChunkValueHash(const SwtiChunk* self, size_t typeIndex, const void* value,
+                       const SwtiValueAccessor* accessor, uint32_t* outHash)
+{
+    const SwtiValuePlan* plan = swtiChunkValuePlan(self, typeIndex);
+    if (plan == 0) {
+        return -1;
+    }
+
+    *outHash = SWTI_VALUE_HASH_SEED;
+
+    return planHash(self, plan, (const uint8_t*) value, accessor, outHash);
+}
@@ -0,0 +1,65 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/value.h>
+
+static int runCopyPlan(const SwtiChunk* chunk, const SwtiValuePlan* plan, uint8_t* target, const uint8_t* source,
+                       const SwtiValueCopier* copier)
+{
+    int error;
+    for (size_t i = 0; i < plan->stepCount; ++i) {
+        const SwtiValueStep* step = &plan->steps[i];
+        uint8_t* targetSlot = target + step->offset;
+        const uint8_t* sourceSlot = source + step->offset;
+        switch (step->kind) {
+            case SwtiValueStepBlock:
+                tc_memcpy_octets(targetSlot, sourceSlot, step->size);
+                break;
+            case SwtiValueStepCustom: {
+                tc_memcpy_octets(targetSlot, sourceSlot, step->size);
+                uint8_t tag = *sourceSlot;
+                const SwtiValuePlan* customPlan = swtiChunkCopyPlan(chunk, step->typeIndex);
+                if (customPlan == 0 || tag >= customPlan->variantCount) {
+                    CLOG_SOFT_ERROR("value copy: illegal tag %d", tag)
+                    return -4;
+                }
+                if ((error = runCopyPlan(chunk, customPlan->variantPlans[tag], targetSlot, sourceSlot, copier)) < 0) {
+                    return error;
+                }
+            } break;
+            default:
+                if (copier == 0 || copier->copyReference == 0) {
+                    tc_memcpy_octets(targetSlot, sourceSlot, step->size);
+                } else if ((error = copier->copyReference(copier->userData, step, targetSlot, sourceSlot)) < 0) {
+                    return error;
+                }
+                break;
+        }
+    }
+
+    return 0;
+}
+
+/***
+ * Copies a value. Plain data is copied with a few blits and each reference is handed to the copier, which decides
+ * if the referenced value is shared or cloned.
+ * @param self
+ * @param typeIndex the type of the value.
+ * @param target where to copy the value to, must not overlap @p source.
+ * @param source the value to copy.
+ * @param copier copies the referenced values. If it is null, the references are copied as is (a shallow copy).
+ * @return negative on error.
+ */
+int swtiChunkValueCopy(const SwtiChunk* self, size_t typeIndex, void* target, const void* source,
+                       const SwtiValueCopier* copier)
+{
+    const SwtiValuePlan* plan = swtiChunkCopyPlan(self, typeIndex);
+    if (plan == 0) {
+        return -1;
+    }
+
+    return runCopyPlan(self, plan, (uint8_t*) target, (const uint8_t*) source, copier);
+}
@@ -0,0 +1,450 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <swamp-typeinfo/chunk.h>
+#include <swamp-typeinfo/typeinfo.h>
+#include <swamp-typeinfo/value.h>
+
+#define SWTI_VALUE_PLAN_MIN_STEPS (16)
+
+/// Cached for types that could not get a plan, so they are not compiled (and logged) again on each request
+static const SwtiValuePlan noPlan;
+
+/***
+ * Collects the steps for a plan. Most plans fit in the inline steps, larger ones are moved to the chunk allocator,
+ * and the finished plan then takes over those steps as they are.
+ */
+typedef struct SwtiValuePlanBuilder {
+    const SwtiChunk* chunk;
+    SwtiValueStep* steps;
+    size_t stepCount;
+    size_t capacity;
+    SwtiValueStep inlineSteps[SWTI_VALUE_PLAN_MIN_STEPS];
+} SwtiValuePlanBuilder;
+
+static void builderInit(SwtiValuePlanBuilder* self, const SwtiChunk* chunk)
+{
+    self->chunk = chunk;
+    self->steps = self->inlineSteps;
+    self->stepCount = 0;
+    self->capacity = SWTI_VALUE_PLAN_MIN_STEPS;
+}
+
+static int emitStep(SwtiValuePlanBuilder* self, SwtiValueStepKind kind, size_t offset, SwtiMemorySize size,
+                    size_t typeIndex)
+{
+    if (offset > 0xffff) {
+        CLOG_SOFT_ERROR("value plan: offset %zu is too large", offset)
+        return -2;
+    }
+
+    if (self->stepCount == self->capacity) {
+        size_t capacity = self->capacity * 2;
+        SwtiValueStep* steps = IMPRINT_ALLOC_TYPE_COUNT(self->chunk->allocator, SwtiValueStep, capacity);
+        if (steps == 0) {
+            return -1;
+        }
+        tc_memcpy_type(SwtiValueStep, steps, self->steps, self->stepCount);
+        self->steps = steps;
+        self->capacity = capacity;
+    }
+
+    SwtiValueStep* step = &self->steps[self->stepCount++];
+    step->kind = (uint8_t) kind;
+    step->offset = (SwtiMemoryOffset) offset;
+    step->size = size;
+    step->typeIndex = (uint32_t) typeIndex;
+
+    return 0;
+}
+
+static int typeIndexInChunk(const SwtiChunk* chunk, const SwtiType* type)
+{
+    if ((uintptr_t) (const void*) type < 256 || type->index >= chunk->typeCount || chunk->types[type->index] != type) {
+        CLOG_SOFT_ERROR("value plan: referenced type is not in the chunk")
+        return -1;
+    }
+
+    return (int) type->index;
+}
+
+static int emitType(SwtiValuePlanBuilder* self, size_t typeIndex, size_t offset);
+
+static int emitReferencedType(SwtiValuePlanBuilder* self, const SwtiType* type, size_t offset)
+{
+    int typeIndex = typeIndexInChunk(self->chunk, type);
+    if (typeIndex < 0) {
+        return typeIndex;
+    }
+
+    return emitType(self, (size_t) typeIndex, offset);
+}
+
+static int emitReference(SwtiValuePlanBuilder* self, SwtiValueStepKind kind, size_t offset, SwtiMemorySize size,
+                         const SwtiType* itemType)
+{
+    int itemTypeIndex = typeIndexInChunk(self->chunk, itemType);
+    if (itemTypeIndex < 0) {
+        return itemTypeIndex;
+    }
+
+    return emitStep(self, kind, offset, size, (size_t) itemTypeIndex);
+}
+
+static int emitType(SwtiValuePlanBuilder* self, size_t typeIndex, size_t offset)
+{
+    size_t index = swtiChunkUnaliasIndex(self->chunk, typeIndex);
+    const SwtiType* type = swtiChunkTypeFromIndex(self->chunk, index);
+    if (type == 0) {
+        return -1;
+    }
+
+    SwtiMemorySize size = self->chunk->layouts[index].memorySize;
+    int error;
+
+    switch (type->type) {
+        case SwtiTypeInt:
+        case SwtiTypeFixed:
+        case SwtiTypeChar:
+        case SwtiTypeBoolean:
+        case SwtiTypeRefId:
+            return emitStep(self, SwtiValueStepBlock, offset, size, index);
+        case SwtiTypeUnmanaged:
+            return emitStep(self, SwtiValueStepUnmanaged, offset, size, index);
+        case SwtiTypeString:
+            return emitStep(self, SwtiValueStepString, offset, size, index);
+        case SwtiTypeBlob:
+            return emitStep(self, SwtiValueStepBlob, offset, size, index);
+        case SwtiTypeList:
+            return emitReference(self, SwtiValueStepList, offset, size, ((const SwtiListType*) type)->itemType);
+        case SwtiTypeArray:
+            return emitReference(self, SwtiValueStepArray, offset, size, ((const SwtiArrayType*) type)->itemType);
+        case SwtiTypeCustom:
+            return emitStep(self, SwtiValueStepCustom, offset, size, index);
+        case SwtiTypeRecord: {
+            const SwtiRecordType* record = (const SwtiRecordType*) type;
+            for (size_t i = 0; i < record->fieldCount; ++i) {
+                const SwtiRecordTypeField* field = &record->fields[i];
+                if ((error = emitReferencedType(self, field->fieldType, offset + field->memoryOffsetInfo.memoryOffset)) < 0) {
+                    return error;
+                }
+            }
+            return 0;
+        }
+        case SwtiTypeTuple: {
+            const SwtiTupleType* tuple = (const SwtiTupleType*) type;
+            for (size_t i = 0; i < tuple->fieldCount; ++i) {
+                const SwtiTupleTypeField* field = &tuple->fields[i];
+                if ((error = emitReferencedType(self, field->fieldType, offset + field->memoryOffsetInfo.memoryOffset)) < 0) {
+                    return error;
+                }
+            }
+            return 0;
+        }
+        default:
+            CLOG_SOFT_ERROR("value plan: type kind %d has no value layout", type->type)
+            return -3;
+    }
+}
+
+static int emitVariant(SwtiValuePlanBuilder* self, const SwtiCustomTypeVariant* variant)
+{
+    int error;
+    for (size_t i = 0; i < variant->paramCount; ++i) {
+        const SwtiCustomTypeVariantField* field = &variant->fields[i];
+        if ((error = emitReferencedType(self, field->fieldType, field->memoryOffsetInfo.memoryOffset)) < 0) {
+            return error;
+        }
+    }
+
+    return 0;
+}
+
+/// Sorts the steps on offset and folds adjacent blocks into one.
+static void foldSteps(SwtiValuePlanBuilder* self)
+{
+    for (size_t i = 1; i < self->stepCount; ++i) {
+        SwtiValueStep step = self->steps[i];
+        size_t j = i;
+        while (j > 0 && self->steps[j - 1].offset > step.offset) {
+            self->steps[j] = self->steps[j - 1];
+            j--;
+        }
+        self->steps[j] = step;
+    }
+
+    size_t target = 0;
+    for (size_t i = 0; i < self->stepCount; ++i) {
+        const SwtiValueStep* step = &self->steps[i];
+        if (target > 0) {
+            SwtiValueStep* previous = &self->steps[target - 1];
+            if (step->kind == SwtiValueStepBlock && previous->kind == SwtiValueStepBlock &&
+                (size_t) previous->offset + previous->size == step->offset) {
+                previous->size += step->size;
+                continue;
+            }
+        }
+        self->steps[target++] = *step;
+    }
+    self->stepCount = target;
+}
+
+static SwtiValuePlan* finishPlan(SwtiValuePlanBuilder* self, SwtiMemoryInfo memoryInfo)
+{
+    foldSteps(self);
+
+    ImprintAllocator* allocator = self->chunk->allocator;
+    SwtiValuePlan* plan = IMPRINT_ALLOC_TYPE(allocator, SwtiValuePlan);
+    SwtiValueStep* steps = self->steps;
+    if (steps == self->inlineSteps) {
+        steps = IMPRINT_ALLOC_TYPE_COUNT(allocator, SwtiValueStep, self->stepCount);
+        if (steps != 0 && self->stepCount > 0) {
+            tc_memcpy_type(SwtiValueStep, steps, self->steps, self->stepCount);
+        }
+    }
+    if (plan == 0 || (steps == 0 && self->stepCount > 0)) {
+        CLOG_SOFT_ERROR("value plan: out of memory")
+        return 0;
+    }
+
+    plan->steps = steps;
+    plan->stepCount = self->stepCount;
+    plan->memoryInfo = memoryInfo;
+    plan->variantPlans = 0;
+    plan->variantCount = 0;
+
+    return plan;
+}
+
+static SwtiValuePlan* compileVariant(const SwtiChunk* chunk, const SwtiCustomTypeVariant* variant)
+{
+    SwtiValuePlanBuilder builder;
+    builderInit(&builder, chunk);
+
+    SwtiValuePlan* plan = 0;
+    if (emitVariant(&builder, variant) >= 0) {
+        plan = finishPlan(&builder, variant->memoryInfo);
+    }
+
+    return plan;
+}
+
+static SwtiValuePlan* compilePlan(const SwtiChunk* chunk, size_t index)
+{
+    SwtiValuePlanBuilder builder;
+    builderInit(&builder, chunk);
+
+    SwtiValuePlan* plan = 0;
+    if (emitType(&builder, index, 0) >= 0) {
+        plan = finishPlan(&builder, chunk->layouts[index]);
+    }
+
+    if (plan == 0 || chunk->kinds[index] != SwtiTypeCustom) {
+        return plan;
+    }
+
+    const SwtiCustomType* custom = (const SwtiCustomType*) swtiChunkTypeFromIndex(chunk, index);
+    const SwtiValuePlan** variantPlans = IMPRINT_ALLOC_TYPE_COUNT(chunk->allocator, const SwtiValuePlan*,
+                                                                   custom->variantCount);
+    if (variantPlans == 0 && custom->variantCount > 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < custom->variantCount; ++i) {
+        variantPlans[i] = compileVariant(chunk, custom->variantTypes[i]);
+        if (variantPlans[i] == 0) {
+            return 0;
+        }
+    }
+    plan->variantPlans = variantPlans;
+    plan->variantCount = custom->variantCount;
+
+    return plan;
+}
+
+/***
+ * Gets the value plan for a type. The plan is compiled the first time it is requested and then cached in the chunk.
+ * The cache is only written for chunks that are not frozen, which are used from one thread. A frozen chunk already
+ * has all its plans, so it is only read.
+ * @param self
+ * @param typeIndex the type index, aliases are resolved.
+ * @return the plan, or null if the type has no value layout (e.g. functions) or is not in the chunk.
+ */
+const SwtiValuePlan* swtiChunkValuePlan(const SwtiChunk* self, size_t typeIndex)
+{
+    size_t index = swtiChunkUnaliasIndex(self, typeIndex);
+    if (index >= self->typeCount) {
+        return 0;
+    }
+    const SwtiValuePlan* plan = self->valuePlans[index];
+    // A frozen chunk has all the plans it can have, a missing plan means that the type has no value layout
+    if (plan == 0 && !self->frozen) {
+        plan = compilePlan(self, index);
+        self->valuePlans[index] = plan != 0 ? plan : &noPlan;
+    }
+
+    return plan == &noPlan ? 0 : plan;
+}
+
+/***
+ * Gets the distance between two values of the type when they are stored after each other, e.g. in a list.
+ * @param self
+ * @param typeIndex the type index, aliases are resolved.
+ * @return the stride in octets, zero if the type is not in the chunk.
+ */
+size_t swtiChunkValueStride(const SwtiChunk* self, size_t typeIndex)
+{
+    size_t index = swtiChunkUnaliasIndex(self, typeIndex);
+    if (index >= self->typeCount) {
+        return 0;
+    }
+
+    const SwtiMemoryInfo* info = &self->layouts[index];
+    if (info->memoryAlign <= 1) {
+        return info->memorySize;
+    }
+
+    return (info->memorySize + info->memoryAlign - 1) / info->memoryAlign * info->memoryAlign;
+}
+
+static int isPlainCopy(const SwtiValuePlan* copyPlan)
+{
+    for (size_t i = 0; i < copyPlan->stepCount; ++i) {
+        if (copyPlan->steps[i].kind != SwtiValueStepBlock) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/// Everything that is not a reference is copied with blits, including the padding. References and custom types that
+/// contain references get their own steps.
+static int emitCopySteps(SwtiValuePlanBuilder* self, const SwtiValuePlan* valuePlan, size_t size, int withBlits)
+{
+    size_t cursor = 0;
+    int error;
+    for (size_t i = 0; i < valuePlan->stepCount; ++i) {
+        const SwtiValueStep* step = &valuePlan->steps[i];
+        if (step->kind == SwtiValueStepBlock) {
+            continue;
+        }
+        if (step->kind == SwtiValueStepCustom) {
+            const SwtiValuePlan* customCopyPlan = swtiChunkCopyPlan(self->chunk, step->typeIndex);
+            if (customCopyPlan == 0) {
+                return -1;
+            }
+            if (isPlainCopy(customCopyPlan)) {
+                continue;
+            }
+        }
+        if (withBlits && step->offset > cursor) {
+            if ((error = emitStep(self, SwtiValueStepBlock, cursor, (SwtiMemorySize) (step->offset - cursor), 0)) < 0) {
+                return error;
+            }
+        }
+        if ((error = emitStep(self, (SwtiValueStepKind) step->kind, step->offset, step->size, step->typeIndex)) < 0) {
+            return error;
+        }
+        cursor = (size_t) step->offset + step->size;
+    }
+
+    if (withBlits && size > cursor) {
+        return emitStep(self, SwtiValueStepBlock, cursor, (SwtiMemorySize) (size - cursor), 0);
+    }
+
+    return 0;
+}
+
+static SwtiValuePlan* compileReferenceSteps(const SwtiChunk* chunk, const SwtiValuePlan* variantValuePlan)
+{
+    SwtiValuePlanBuilder builder;
+    builderInit(&builder, chunk);
+
+    SwtiValuePlan* plan = 0;
+    if (emitCopySteps(&builder, variantValuePlan, 0, 0) >= 0) {
+        plan = finishPlan(&builder, variantValuePlan->memoryInfo);
+    }
+
+    return plan;
+}
+
+static SwtiValuePlan* compileCustomCopyPlan(const SwtiChunk* chunk, size_t index, const SwtiValuePlan* valuePlan)
+{
+    const SwtiValuePlan** variantPlans = IMPRINT_ALLOC_TYPE_COUNT(chunk->allocator, const SwtiValuePlan*,
+                                                                   valuePlan->variantCount);
+    if (variantPlans == 0 && valuePlan->variantCount > 0) {
+        return 0;
+    }
+
+    int hasReferences = 0;
+    for (size_t i = 0; i < valuePlan->variantCount; ++i) {
+        variantPlans[i] = compileReferenceSteps(chunk, valuePlan->variantPlans[i]);
+        if (variantPlans[i] == 0) {
+            return 0;
+        }
+        hasReferences |= variantPlans[i]->stepCount > 0;
+    }
+
+    SwtiValuePlanBuilder builder;
+    builderInit(&builder, chunk);
+
+    SwtiMemorySize size = chunk->layouts[index].memorySize;
+    SwtiValuePlan* plan = 0;
+    if (emitStep(&builder, hasReferences ? SwtiValueStepCustom : SwtiValueStepBlock, 0, size, index) >= 0) {
+        plan = finishPlan(&builder, chunk->layouts[index]);
+    }
+
+    if (plan != 0) {
+        plan->variantPlans = variantPlans;
+        plan->variantCount = valuePlan->variantCount;
+    }
+
+    return plan;
+}
+
+static SwtiValuePlan* compileCopyPlan(const SwtiChunk* chunk, size_t index)
+{
+    const SwtiValuePlan* valuePlan = swtiChunkValuePlan(chunk, index);
+    if (valuePlan == 0) {
+        return 0;
+    }
+
+    if (chunk->kinds[index] == SwtiTypeCustom) {
+        return compileCustomCopyPlan(chunk, index, valuePlan);
+    }
+
+    SwtiValuePlanBuilder builder;
+    builderInit(&builder, chunk);
+
+    SwtiValuePlan* plan = 0;
+    if (emitCopySteps(&builder, valuePlan, chunk->layouts[index].memorySize, 1) >= 0) {
+        plan = finishPlan(&builder, chunk->layouts[index]);
+    }
+
+    return plan;
+}
+
+/***
+ * Gets the copy plan for a type. The plan is derived from the value plan the first time it is requested and then
+ * cached in the chunk, like in swtiChunkValuePlan().
+ * @param self
+ * @param typeIndex the type index, aliases are resolved.
+ * @return the plan, or null if the type has no value layout (e.g. functions) or is not in the chunk.
+ */
+const SwtiValuePlan* swtiChunkCopyPlan(const SwtiChunk* self, size_t typeIndex)
+{
+    size_t index = swtiChunkUnaliasIndex(self, typeIndex);
+    if (index >= self->typeCount) {
+        return 0;
+    }
+    const SwtiValuePlan* plan = self->copyPlans[index];
+    if (plan == 0 && !self->frozen) {
+        plan = compileCopyPlan(self, index);
+        self->copyPlans[index] = plan != 0 ? plan : &noPlan;
+    }
+
+    return plan == &noPlan ? 0 : plan;
+}
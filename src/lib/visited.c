@@ -0,0 +1,186 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <imprint/allocator.h>
+#include <swamp-typeinfo/hash.h>
+#include <swamp-typeinfo/visited.h>
+
+#define SWTI_TYPE_VISITED_MIN_CAPACITY (64)
+
+static size_t pointerSlot(const struct SwtiType* key, size_t capacity)
+{
+    uintptr_t value = (uintptr_t) (const void*) key;
+    value ^= value >> 17;
+    value *= 0x9e3779b1u;
+
+    return (value ^ (value >> 15)) & (capacity - 1);
+}
+
+/// Slots that were filled before the last swtiTypeVisitedClear() count as empty
+static int isUsed(const SwtiTypeVisited* self, size_t slot)
+{
+    return self->keys[slot] != 0 && self->generations[slot] == self->generation;
+}
+
+/// Returns the slot that holds the key, or the empty slot where it should go
+static size_t findSlot(const SwtiTypeVisited* self, const struct SwtiType* key)
+{
+    size_t slot = pointerSlot(key, self->capacity);
+    while (isUsed(self, slot) && self->keys[slot] != key) {
+        slot = (slot + 1) & (self->capacity - 1);
+    }
+
+    return slot;
+}
+
+static int grow(SwtiTypeVisited* self)
+{
+    SwtiTypeVisited grown;
+    grown.capacity = self->capacity == 0 ? SWTI_TYPE_VISITED_MIN_CAPACITY : self->capacity * 2;
+    grown.count = self->count;
+    grown.generation = self->generation;
+    grown.allocator = self->allocator;
+    grown.keys = IMPRINT_CALLOC_TYPE_COUNT(self->allocator, const struct SwtiType*, grown.capacity);
+    grown.values = IMPRINT_ALLOC_TYPE_COUNT(self->allocator, int, grown.capacity);
+    grown.hashes = IMPRINT_ALLOC_TYPE_COUNT(self->allocator, uint32_t, grown.capacity);
+    grown.generations = IMPRINT_CALLOC_TYPE_COUNT(self->allocator, uint32_t, grown.capacity);
+    if (grown.keys == 0 || grown.values == 0 || grown.hashes == 0 || grown.generations == 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < self->capacity; ++i) {
+        if (isUsed(self, i)) {
+            size_t slot = findSlot(&grown, self->keys[i]);
+            grown.keys[slot] = self->keys[i];
+            grown.generations[slot] = grown.generation;
+            grown.values[slot] = self->values[i];
+            grown.hashes[slot] = self->hashes[i];
+        }
+    }
+
+    *self = grown;
+
+    return 0;
+}
+
+/// Returns the slot for the key, adding it (with no value and no hash) if needed. Negative on error.
+static int addSlot(SwtiTypeVisited* self, const struct SwtiType* key)
+{
+    if ((self->count + 1) * 2 > self->capacity && grow(self) < 0) {
+        return -1;
+    }
+
+    size_t slot = findSlot(self, key);
+    if (!isUsed(self, slot)) {
+        self->keys[slot] = key;
+        self->generations[slot] = self->generation;
+        self->values[slot] = -1;
+        self->hashes[slot] = 0;
+        self->count++;
+    }
+
+    return (int) slot;
+}
+
+/***
+ * Initializes an empty visited map.
+ * @param self
+ * @param allocator the allocator for the table, e.g. the allocator of the chunk that is walked into.
+ */
+void swtiTypeVisitedInit(SwtiTypeVisited* self, struct ImprintAllocator* allocator)
+{
+    self->keys = 0;
+    self->values = 0;
+    self->hashes = 0;
+    self->generations = 0;
+    self->capacity = 0;
+    self->count = 0;
+    self->generation = 1;
+    self->allocator = allocator;
+}
+
+/***
+ * Forgets all the visited types, but keeps the table so it can be reused for the next walk.
+ * @param self
+ */
+void swtiTypeVisitedClear(SwtiTypeVisited* self)
+{
+    self->count = 0;
+    self->generation++;
+    if (self->generation == 0) {
+        for (size_t i = 0; i < self->capacity; ++i) {
+            self->generations[i] = 0;
+        }
+        self->generation = 1;
+    }
+}
+
+/***
+ * Finds the value for a type.
+ * @param self
+ * @param type the type to look up.
+ * @return the value, or -1 if the type has not been visited (or has no value).
+ */
+int swtiTypeVisitedFind(const SwtiTypeVisited* self, const struct SwtiType* type)
+{
+    if (self->capacity == 0) {
+        return -1;
+    }
+
+    size_t slot = findSlot(self, type);
+
+    return isUsed(self, slot) ? self->values[slot] : -1;
+}
+
+/***
+ * Sets the value for a type.
+ * @param self
+ * @param type the type that has been visited.
+ * @param value zero or positive.
+ * @return negative on error.
+ */
+int swtiTypeVisitedInsert(SwtiTypeVisited* self, const struct SwtiType* type, int value)
+{
+    int slot = addSlot(self, type);
+    if (slot < 0) {
+        return slot;
+    }
+    self->values[slot] = value;
+
+    return 0;
+}
+
+static uint32_t memoFind(void* userData, const struct SwtiType* type)
+{
+    const SwtiTypeVisited* self = (const SwtiTypeVisited*) userData;
+    if (self->capacity == 0) {
+        return 0;
+    }
+
+    size_t slot = findSlot(self, type);
+
+    return isUsed(self, slot) ? self->hashes[slot] : 0;
+}
+
+/// The memo is only a cache, if the hash can not be stored it is simply calculated again the next time
+static void memoStore(void* userData, const struct SwtiType* type, uint32_t hash)
+{
+    SwtiTypeVisited* self = (SwtiTypeVisited*) userData;
+    int slot = addSlot(self, type);
+    if (slot >= 0) {
+        self->hashes[slot] = hash;
+    }
+}
+
+/***
+ * Sets up a memo (see swtiChunkTypeHashWithMemo()) that remembers the hashes in the visited map.
+ * @param self
+ * @param memo the memo to set up.
+ */
+void swtiTypeVisitedHashMemo(SwtiTypeVisited* self, SwtiTypeHashMemo* memo)
+{
+    memo->find = memoFind;
+    memo->store = memoStore;
+    memo->userData = self;
+}